@@ -0,0 +1,368 @@
+/*
+ * Memory-mappable share archives
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * The header is:
+ *
+ *     offset  size  field
+ *          0     8  magic ("sssarch" followed by a zero byte)
+ *          8     4  version
+ *         12     4  length of a share (`sss_SHARE_LEN`)
+ *         16     4  shares per record
+ *         20     4  length of a record (a multiple of 64)
+ *         24     8  amount of secrets
+ *         32     8  offset of the index
+ *         40     8  offset of the first record
+ *         48    16  reserved (zero)
+ *
+ * The shares themselves are not secret on their own, so the archive is not
+ * encrypted and the mapping is not locked.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "archive.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#define INDEX_ENTRY_LEN 16
+#define ALIGN_UP(x) (((x) + sss_ARCHIVE_ALIGN - 1) & ~(uint64_t) (sss_ARCHIVE_ALIGN - 1))
+
+
+static const uint8_t magic[8] = { 's', 's', 's', 'a', 'r', 'c', 'h', 0 };
+static const uint8_t stream_magic[8] = { 's', 's', 's', 's', 't', 'r', 'm', 0 };
+
+
+struct sss_Archive {
+	uint8_t *map;
+	size_t map_len;
+	uint64_t count;
+	uint8_t m;
+	uint32_t record_len;
+	const uint8_t *index;
+	uint8_t *records; /* read only */
+};
+
+
+static void store32(uint8_t *p, uint32_t x)
+{
+	size_t idx;
+	for (idx = 0; idx < 4; idx++) p[idx] = x >> (8 * idx);
+}
+
+
+static void store64(uint8_t *p, uint64_t x)
+{
+	size_t idx;
+	for (idx = 0; idx < 8; idx++) p[idx] = x >> (8 * idx);
+}
+
+
+static uint32_t load32(const uint8_t *p)
+{
+	return (uint32_t) p[0] | (uint32_t) p[1] << 8 |
+	       (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+
+static uint64_t load64(const uint8_t *p)
+{
+	return (uint64_t) load32(p) | (uint64_t) load32(&p[4]) << 32;
+}
+
+
+/*
+ * Sort `order` (indices into `ids`) by id, with a heap sort, so that we do
+ * not need a global for `qsort`
+ */
+static void sift_down(size_t *order, const uint64_t *ids, size_t root,
+                      size_t len)
+{
+	size_t child, tmp;
+
+	while ((child = 2 * root + 1) < len) {
+		if (child + 1 < len && ids[order[child + 1]] > ids[order[child]]) {
+			child++;
+		}
+		if (ids[order[root]] >= ids[order[child]]) return;
+		tmp = order[root];
+		order[root] = order[child];
+		order[child] = tmp;
+		root = child;
+	}
+}
+
+
+/*
+ * Sync the directory that holds the file at `path`. This overwrites `path`
+ * with the name of the directory.
+ */
+static int sync_dir(char *path)
+{
+	char *slash = strrchr(path, '/');
+	int fd, ret;
+
+	if (slash == NULL) {
+		strcpy(path, ".");
+	} else {
+		slash[slash == path] = 0;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	ret = fsync(fd);
+	if (close(fd) != 0) ret = -1;
+	return ret == 0 ? 0 : -1;
+}
+
+
+static void sort_ids(size_t *order, const uint64_t *ids, size_t count)
+{
+	size_t idx, tmp;
+
+	for (idx = 0; idx < count; idx++) order[idx] = idx;
+	for (idx = count / 2; idx-- > 0;) sift_down(order, ids, idx, count);
+	for (idx = count; idx-- > 1;) {
+		tmp = order[0];
+		order[0] = order[idx];
+		order[idx] = tmp;
+		sift_down(order, ids, 0, idx);
+	}
+}
+
+
+int sss_archive_write(const char *path,
+                      const uint64_t *ids,
+                      const sss_Share *shares,
+                      size_t count,
+                      uint8_t m)
+{
+	uint8_t header[sss_ARCHIVE_ALIGN] = { 0 };
+	uint8_t entry[INDEX_ENTRY_LEN];
+	uint8_t pad[sss_ARCHIVE_ALIGN] = { 0 };
+	uint64_t index_offset = sss_ARCHIVE_ALIGN;
+	uint64_t records_offset = ALIGN_UP(index_offset + count * INDEX_ENTRY_LEN);
+	uint32_t record_len = ALIGN_UP((uint64_t) m * sss_SHARE_LEN);
+	size_t *order, idx, data_len = (size_t) m * sss_SHARE_LEN;
+	char *tmp_path;
+	FILE *file;
+	int fd, ok;
+
+	assert(m != 0);
+
+	order = malloc((count ? count : 1) * sizeof(size_t));
+	if (order == NULL) return -1;
+	sort_ids(order, ids, count);
+	for (idx = 1; idx < count; idx++) {
+		if (ids[order[idx - 1]] == ids[order[idx]]) {
+			free(order);
+			return -1;
+		}
+	}
+
+	memcpy(header, magic, sizeof(magic));
+	store32(&header[8], sss_ARCHIVE_VERSION);
+	store32(&header[12], sss_SHARE_LEN);
+	store32(&header[16], m);
+	store32(&header[20], record_len);
+	store64(&header[24], count);
+	store64(&header[32], index_offset);
+	store64(&header[40], records_offset);
+
+	/*
+	 * Write to `path.tmp` and only rename it over `path` once it is on disk,
+	 * so a crash or a full disk never destroys the previous archive
+	 */
+	tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+	if (tmp_path == NULL) {
+		free(order);
+		return -1;
+	}
+	strcpy(tmp_path, path);
+	strcat(tmp_path, ".tmp");
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+	if (file == NULL) {
+		if (fd >= 0) close(fd);
+		free(tmp_path);
+		free(order);
+		return -1;
+	}
+	ok = fwrite(header, sizeof(header), 1, file) == 1;
+
+	/* The records keep the order of the input, only the index is sorted */
+	for (idx = 0; ok && idx < count; idx++) {
+		store64(&entry[0], ids[order[idx]]);
+		store64(&entry[8], order[idx]);
+		ok = fwrite(entry, sizeof(entry), 1, file) == 1;
+	}
+	idx = records_offset - (index_offset + count * INDEX_ENTRY_LEN);
+	if (ok && idx > 0) ok = fwrite(pad, idx, 1, file) == 1;
+	for (idx = 0; ok && idx < count; idx++) {
+		ok = fwrite(&shares[idx * m], data_len, 1, file) == 1;
+		if (ok && record_len > data_len) {
+			ok = fwrite(pad, record_len - data_len, 1, file) == 1;
+		}
+	}
+	ok &= fflush(file) == 0;
+	ok &= fsync(fd) == 0;
+	ok &= fclose(file) == 0;
+	if (ok) ok = rename(tmp_path, path) == 0;
+	if (!ok) remove(tmp_path);
+
+	/* The rename itself is only durable once the directory is synced */
+	if (ok) ok = sync_dir(tmp_path) == 0;
+	free(tmp_path);
+	free(order);
+	return ok ? 0 : -1;
+}
+
+
+sss_Archive* sss_archive_open(const char *path)
+{
+	sss_Archive *archive;
+	struct stat st;
+	uint8_t *map;
+	uint64_t index_offset, records_offset, idx;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+	if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sss_ARCHIVE_ALIGN) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return NULL;
+
+	archive = calloc(1, sizeof(*archive));
+	if (archive == NULL) goto fail;
+	archive->map = map;
+	archive->map_len = st.st_size;
+
+	/* Check the header */
+	if (memcmp(map, magic, sizeof(magic)) != 0 ||
+	    load32(&map[8]) != sss_ARCHIVE_VERSION ||
+	    load32(&map[12]) != sss_SHARE_LEN ||
+	    load32(&map[16]) == 0 || load32(&map[16]) > 255) {
+		goto fail;
+	}
+	archive->m = load32(&map[16]);
+	archive->record_len = load32(&map[20]);
+	archive->count = load64(&map[24]);
+	index_offset = load64(&map[32]);
+	records_offset = load64(&map[40]);
+	if (archive->record_len < archive->m * sss_SHARE_LEN ||
+	    archive->record_len % sss_ARCHIVE_ALIGN != 0 ||
+	    records_offset % sss_ARCHIVE_ALIGN != 0 ||
+	    index_offset < sss_ARCHIVE_ALIGN ||
+	    index_offset > records_offset ||
+	    records_offset > (uint64_t) st.st_size ||
+	    archive->count > (records_offset - index_offset) / INDEX_ENTRY_LEN ||
+	    archive->count > (st.st_size - records_offset) / archive->record_len) {
+		goto fail;
+	}
+	archive->index = &map[index_offset];
+	archive->records = &map[records_offset];
+
+	/* Check the index, so that lookups can trust it */
+	for (idx = 0; idx < archive->count; idx++) {
+		if (load64(&archive->index[idx * INDEX_ENTRY_LEN + 8]) >=
+		    archive->count) {
+			goto fail;
+		}
+		if (idx > 0 && load64(&archive->index[idx * INDEX_ENTRY_LEN]) <=
+		    load64(&archive->index[(idx - 1) * INDEX_ENTRY_LEN])) {
+			goto fail;
+		}
+	}
+
+	/* Lookups jump around in the records */
+	posix_madvise(archive->records,
+	              st.st_size - records_offset, POSIX_MADV_RANDOM);
+	return archive;
+
+fail:
+	munmap(map, st.st_size);
+	free(archive);
+	return NULL;
+}
+
+
+size_t sss_archive_count(const sss_Archive *archive)
+{
+	return archive->count;
+}
+
+
+uint8_t sss_archive_shares_per_secret(const sss_Archive *archive)
+{
+	return archive->m;
+}
+
+
+const sss_Share* sss_archive_find(const sss_Archive *archive, uint64_t id)
+{
+	uint64_t lo = 0, hi = archive->count, mid, cur;
+	const uint8_t *entry;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		entry = &archive->index[mid * INDEX_ENTRY_LEN];
+		cur = load64(entry);
+		if (cur == id) {
+			return (const sss_Share*) &archive->records[
+			       load64(&entry[8]) * archive->record_len];
+		} else if (cur < id) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return NULL;
+}
+
+
+void sss_archive_close(sss_Archive *archive)
+{
+	if (archive == NULL) return;
+	munmap(archive->map, archive->map_len);
+	free(archive);
+}
+
+
+void sss_stream_header(uint8_t header[sss_STREAM_HEADER_LEN])
+{
+	memcpy(header, stream_magic, sizeof(stream_magic));
+	store32(&header[8], sss_STREAM_VERSION);
+	store32(&header[12], sss_SHARE_LEN);
+}
+
+
+int sss_stream_check_header(const uint8_t header[sss_STREAM_HEADER_LEN])
+{
+	if (memcmp(header, stream_magic, sizeof(stream_magic)) != 0) return -1;
+	if (load32(&header[8]) != sss_STREAM_VERSION) return -1;
+	if (load32(&header[12]) != sss_SHARE_LEN) return -1;
+	return 0;
+}
+
+
+void sss_stream_put_id(uint8_t *record, uint64_t id)
+{
+	store64(record, id);
+}
+
+
+uint64_t sss_stream_get_id(const uint8_t *record)
+{
+	return load64(record);
+}
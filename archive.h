@@ -0,0 +1,161 @@
+/*
+ * Share archives for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * A share archive is a file with the shares of many secrets, which is meant
+ * to be mapped into memory instead of parsed. It looks like this:
+ *
+ *     | header (64 bytes) | index | padding | records ... |
+ *
+ * The index holds one (secret id, record number) pair of 16 bytes for every
+ * secret, sorted by secret id. Every record holds the same amount of
+ * consecutive `sss_Share`s of one secret, and starts at a multiple of 64
+ * bytes. All integers are stored little endian.
+ *
+ * The shares of a secret are found with a binary search in the index, and
+ * can be passed to `sss_combine_shares` straight from the mapping, so only
+ * the pages that are actually used are read from disk.
+ *
+ * A share stream is the sequential counterpart of an archive, for tools that
+ * read or write the shares of many secrets in one pass. It holds the shares
+ * of a single share holder:
+ *
+ *     | header (16 bytes) | record | record | ... |
+ *
+ * Every record is a secret id (8 bytes) followed by one `sss_Share`, and the
+ * records are sorted by secret id, so the streams of `k` share holders can be
+ * joined with a merge instead of a lookup.
+ */
+
+
+#ifndef sss_ARCHIVE_H_
+#define sss_ARCHIVE_H_
+
+#include "sss.h"
+#include <stddef.h>
+
+
+/*
+ * Version of the archive format
+ */
+#define sss_ARCHIVE_VERSION 1
+
+
+/*
+ * Length of the archive header, and the alignment of every record
+ */
+#define sss_ARCHIVE_ALIGN 64
+
+
+/*
+ * Version of the share stream format
+ */
+#define sss_STREAM_VERSION 1
+
+
+/*
+ * Length of the header of a share stream
+ */
+#define sss_STREAM_HEADER_LEN 16
+
+
+/*
+ * Length of a record in a share stream: a secret id and one share
+ */
+#define sss_STREAM_RECORD_LEN (8 + sss_SHARE_LEN)
+
+
+/*
+ * A share archive that is opened for reading
+ */
+typedef struct sss_Archive sss_Archive;
+
+
+/*
+ * Write an archive to the file at `path`. The archive holds `count` secrets,
+ * where the secret with id `ids[i]` has the `m` shares in
+ * `shares[i * m .. i * m + m - 1]`. The archive is written to `path.tmp`
+ * (mode 0600) and synced, and then renamed over `path`, so an existing file
+ * is only replaced by a complete archive. The directory that holds `path` is
+ * synced after the rename. If that fails, -1 is returned even though `path`
+ * may already hold the new archive.
+ *
+ * Returns 0 on success, and -1 if any of the ids occurs more than once, or if
+ * the file could not be written.
+ */
+int sss_archive_write(const char *path,
+                      const uint64_t *ids,
+                      const sss_Share *shares,
+                      size_t count,
+                      uint8_t m);
+
+
+/*
+ * Map the archive at `path` into memory. The header and the index are
+ * checked, but the records are only read when they are used.
+ *
+ * Returns NULL if the file could not be mapped, or if it is not a valid
+ * archive (for a different version, or a different `sss_MLEN`).
+ */
+sss_Archive* sss_archive_open(const char *path);
+
+
+/*
+ * Return the amount of secrets in `archive`.
+ */
+size_t sss_archive_count(const sss_Archive *archive);
+
+
+/*
+ * Return the amount of shares that `archive` holds for every secret.
+ */
+uint8_t sss_archive_shares_per_secret(const sss_Archive *archive);
+
+
+/*
+ * Find the shares of the secret with id `id` in `archive`. This is a binary
+ * search over the index, which is O(log count).
+ *
+ * Returns a pointer into the mapping, to `sss_archive_shares_per_secret`
+ * consecutive shares, or NULL if there is no such secret. The pointer is
+ * valid until the archive is closed.
+ */
+const sss_Share* sss_archive_find(const sss_Archive *archive, uint64_t id);
+
+
+/*
+ * Unmap and free `archive`.
+ */
+void sss_archive_close(sss_Archive *archive);
+
+
+/*
+ * Write the header of a share stream to `header`.
+ */
+void sss_stream_header(uint8_t header[sss_STREAM_HEADER_LEN]);
+
+
+/*
+ * Check the header of a share stream.
+ *
+ * Returns 0 if `header` is valid, and -1 if it is not the header of a share
+ * stream, or of one with a different version or a different `sss_MLEN`.
+ */
+int sss_stream_check_header(const uint8_t header[sss_STREAM_HEADER_LEN]);
+
+
+/*
+ * Store `id` in the first 8 bytes of `record`. This is also used for other
+ * records that start with a secret id, like the restored secrets that are
+ * written by the recovery tool.
+ */
+void sss_stream_put_id(uint8_t *record, uint64_t id);
+
+
+/*
+ * Return the secret id that is stored in the first 8 bytes of `record`.
+ */
+uint64_t sss_stream_get_id(const uint8_t *record);
+
+
+#endif /* sss_ARCHIVE_H_ */
@@ -0,0 +1,132 @@
+/*
+ * Secure memory arena
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * The arena is one anonymous mapping that looks like this:
+ *
+ *     | guard page | usable pages ... | guard page |
+ *
+ * The guard pages are mapped with PROT_NONE, so overflowing a slab in either
+ * direction crashes instead of reading or writing other memory. The usable
+ * pages are locked once when the arena is created. Slabs are handed out with
+ * a simple bump pointer, which makes allocation and release O(1) apart from
+ * the wiping of the released memory.
+ */
+
+#if defined(__linux__)
+# define _DEFAULT_SOURCE
+#endif
+
+#include "arena.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+
+struct sss_Arena {
+	uint8_t *map, *base;
+	size_t map_len, size, top;
+	int locked;
+};
+
+
+/*
+ * A memset that will not be optimized away by the compiler
+ */
+static void* (*const volatile memset_v)(void*, int, size_t) = memset;
+
+
+void sss_memzero(void *ptr, size_t len)
+{
+	memset_v(ptr, 0, len);
+}
+
+
+sss_Arena* sss_arena_new(size_t size)
+{
+	sss_Arena *arena;
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	void *map;
+
+	arena = calloc(1, sizeof(*arena));
+	if (arena == NULL) return NULL;
+	arena->size = (size + page - 1) / page * page;
+	if (arena->size == 0) arena->size = page;
+	arena->map_len = arena->size + 2 * page;
+
+	map = mmap(NULL, arena->map_len, PROT_NONE,
+	           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		free(arena);
+		return NULL;
+	}
+	arena->map = map;
+	arena->base = &arena->map[page];
+	if (mprotect(arena->base, arena->size, PROT_READ | PROT_WRITE) != 0) {
+		munmap(arena->map, arena->map_len);
+		free(arena);
+		return NULL;
+	}
+#ifdef MADV_DONTDUMP
+	(void) madvise(arena->base, arena->size, MADV_DONTDUMP);
+#endif
+	arena->locked = mlock(arena->base, arena->size) == 0;
+	return arena;
+}
+
+
+int sss_arena_locked(const sss_Arena *arena)
+{
+	return arena->locked;
+}
+
+
+void* sss_arena_alloc(sss_Arena *arena, size_t size)
+{
+	size_t len = (size + sss_ARENA_ALIGN - 1) & ~(size_t) (sss_ARENA_ALIGN - 1);
+	void *ptr;
+
+	if (len < size || len > arena->size - arena->top) return NULL;
+	ptr = &arena->base[arena->top];
+	arena->top += len;
+	/* Released memory is wiped, so the slab is already zeroed */
+	return ptr;
+}
+
+
+size_t sss_arena_mark(const sss_Arena *arena)
+{
+	return arena->top;
+}
+
+
+void sss_arena_release(sss_Arena *arena, size_t mark)
+{
+	assert(mark <= arena->top);
+	sss_memzero(&arena->base[mark], arena->top - mark);
+	arena->top = mark;
+}
+
+
+void sss_arena_reset(sss_Arena *arena)
+{
+	sss_arena_release(arena, 0);
+}
+
+
+void sss_arena_free(sss_Arena *arena)
+{
+	if (arena == NULL) return;
+	sss_memzero(arena->base, arena->top);
+	if (arena->locked) munlock(arena->base, arena->size);
+	munmap(arena->map, arena->map_len);
+	free(arena);
+}
@@ -0,0 +1,86 @@
+/*
+ * Secure memory arena for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * An arena is a pool of memory pages that is locked into RAM once (so it is
+ * never written to swap), excluded from core dumps where the platform
+ * supports it, and surrounded by inaccessible guard pages. Memory is handed
+ * out in cache-aligned slabs and is wiped in bulk when it is released, so
+ * the hot path does not need any system calls.
+ */
+
+
+#ifndef sss_ARENA_H_
+#define sss_ARENA_H_
+
+#include <stddef.h>
+
+
+/*
+ * Alignment of every slab that is handed out by `sss_arena_alloc`
+ */
+#define sss_ARENA_ALIGN 64
+
+
+typedef struct sss_Arena sss_Arena;
+
+
+/*
+ * Map, lock and guard a new arena that can hand out at least `size` bytes.
+ *
+ * Locking the pages may fail when the process hits its RLIMIT_MEMLOCK; in
+ * that case the arena is still usable, but `sss_arena_locked` returns 0.
+ *
+ * Returns NULL if the memory could not be mapped.
+ */
+sss_Arena* sss_arena_new(size_t size);
+
+
+/*
+ * Return 1 if the pages of `arena` are locked into memory, and 0 otherwise.
+ */
+int sss_arena_locked(const sss_Arena *arena);
+
+
+/*
+ * Hand out a slab of `size` bytes from `arena`. The slab is aligned to
+ * `sss_ARENA_ALIGN` bytes and is zeroed.
+ *
+ * Returns NULL if the arena does not have enough space left.
+ */
+void* sss_arena_alloc(sss_Arena *arena, size_t size);
+
+
+/*
+ * Return a mark of the current top of `arena`. Passing this mark to
+ * `sss_arena_release` releases every slab that was handed out after it.
+ */
+size_t sss_arena_mark(const sss_Arena *arena);
+
+
+/*
+ * Wipe and release every slab that was handed out since `mark`.
+ */
+void sss_arena_release(sss_Arena *arena, size_t mark);
+
+
+/*
+ * Wipe and release all of the slabs in `arena`.
+ */
+void sss_arena_reset(sss_Arena *arena);
+
+
+/*
+ * Wipe, unlock and unmap `arena`.
+ */
+void sss_arena_free(sss_Arena *arena);
+
+
+/*
+ * Overwrite `len` bytes at `ptr` with zeroes, in a way that will not be
+ * optimized away by the compiler.
+ */
+void sss_memzero(void *ptr, size_t len);
+
+
+#endif /* sss_ARENA_H_ */
@@ -0,0 +1,311 @@
+/*
+ * Batch API for creating and combining many secrets
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Every worker gets its own workspace with a buffered randomness source, so
+ * the workers do not share any mutable state, and the randomness for many
+ * secrets is read from the OS with a single system call. The secrets are
+ * handed out to the workers in chunks by the work-stealing scheduler of the
+ * thread pool.
+ *
+ * When combining, consecutive secrets usually come from the same custodians.
+ * The workspace then reuses the Lagrange weights of the previous secret,
+ * which makes combining a secret O(k) instead of O(k^2). The `_ctx` variants
+ * take the workspaces from the caller, so that these caches (and the
+ * buffered randomness) also carry over from one batch to the next.
+ */
+
+#include "batch.h"
+#include <assert.h>
+
+
+/*
+ * Amount of secrets that a worker takes from its queue at a time
+ */
+#define GRAIN 16
+
+
+typedef struct {
+	sss_Ctx *ctxs[sss_THREADPOOL_MAX];
+	size_t workers;
+	int owned;
+	uint8_t n, k;
+
+	/* Create and refresh */
+	sss_Share *out;
+	const uint8_t *data;
+
+	/* Reshare */
+	uint8_t n2, k2;
+
+	/* Combine */
+	uint8_t *data_out;
+	int *status;
+	const sss_Share *shares;
+	int failed[sss_THREADPOOL_MAX];
+} Job;
+
+
+static int job_init(Job *job, sss_Threadpool *pool, uint8_t n, uint8_t k)
+{
+	size_t idx;
+
+	job->workers = pool != NULL ? sss_threadpool_size(pool) : 1;
+	job->owned = 1;
+	job->n = n;
+	job->k = k;
+	for (idx = 0; idx < job->workers; idx++) {
+		job->ctxs[idx] = sss_ctx_new(n, k);
+		job->failed[idx] = 0;
+		if (job->ctxs[idx] == NULL) {
+			while (idx-- > 0) sss_ctx_free(job->ctxs[idx]);
+			return -1;
+		}
+		sss_ctx_buffer_randomness(job->ctxs[idx], 1);
+	}
+	return 0;
+}
+
+
+/*
+ * Same as `job_init`, but with the workspaces of the caller
+ */
+static void job_init_ctx(Job *job, sss_Threadpool *pool, sss_Ctx **ctxs,
+                         uint8_t n, uint8_t k)
+{
+	size_t idx;
+
+	job->workers = pool != NULL ? sss_threadpool_size(pool) : 1;
+	job->owned = 0;
+	job->n = n;
+	job->k = k;
+	for (idx = 0; idx < job->workers; idx++) {
+		assert(ctxs[idx] != NULL);
+		job->ctxs[idx] = ctxs[idx];
+		job->failed[idx] = 0;
+	}
+}
+
+
+static void job_free(Job *job)
+{
+	size_t idx;
+
+	if (!job->owned) return;
+	for (idx = 0; idx < job->workers; idx++) sss_ctx_free(job->ctxs[idx]);
+}
+
+
+static int job_failed(const Job *job)
+{
+	size_t idx;
+
+	for (idx = 0; idx < job->workers; idx++) {
+		if (job->failed[idx]) return -1;
+	}
+	return 0;
+}
+
+
+static void run(sss_Threadpool *pool, sss_Task fn, Job *job, size_t count)
+{
+	if (pool != NULL) {
+		sss_threadpool_run_stealing(pool, fn, job, count, GRAIN);
+	} else if (count > 0) {
+		fn(job, 0, count, 0);
+	}
+}
+
+
+static void create_task(void *arg, size_t begin, size_t end, size_t worker)
+{
+	Job *job = arg;
+	size_t idx;
+
+	for (idx = begin; idx < end; idx++) {
+		sss_create_shares_ctx(job->ctxs[worker], &job->out[idx * job->n],
+		                      &job->data[idx * sss_MLEN], job->n, job->k);
+	}
+}
+
+
+static void refresh_task(void *arg, size_t begin, size_t end, size_t worker)
+{
+	Job *job = arg;
+	size_t idx;
+
+	for (idx = begin; idx < end; idx++) {
+		sss_refresh_shares_ctx(job->ctxs[worker], &job->out[idx * job->n],
+		                       job->n, job->k);
+	}
+}
+
+
+static void reshare_task(void *arg, size_t begin, size_t end, size_t worker)
+{
+	Job *job = arg;
+	size_t idx;
+	int ret;
+
+	for (idx = begin; idx < end; idx++) {
+		ret = sss_reshare_shares_ctx(job->ctxs[worker],
+		                             &job->out[idx * job->n2],
+		                             &job->shares[idx * job->k],
+		                             job->k, job->n2, job->k2);
+		if (job->status != NULL) job->status[idx] = ret;
+		if (ret != 0) job->failed[worker] = 1;
+	}
+}
+
+
+static void combine_task(void *arg, size_t begin, size_t end, size_t worker)
+{
+	Job *job = arg;
+	size_t idx;
+	int ret;
+
+	for (idx = begin; idx < end; idx++) {
+		ret = sss_combine_shares_ctx(job->ctxs[worker],
+		                             &job->data_out[idx * sss_MLEN],
+		                             &job->shares[idx * job->k], job->k);
+		if (job->status != NULL) job->status[idx] = ret;
+		if (ret != 0) job->failed[worker] = 1;
+	}
+}
+
+
+int sss_create_shares_batch(sss_Threadpool *pool,
+                            sss_Share *out,
+                            const uint8_t *data,
+                            size_t count,
+                            uint8_t n,
+                            uint8_t k)
+{
+	Job job;
+
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	if (job_init(&job, pool, n, k) != 0) return -1;
+	job.out = out;
+	job.data = data;
+	run(pool, create_task, &job, count);
+	job_free(&job);
+	return 0;
+}
+
+
+int sss_combine_shares_batch(sss_Threadpool *pool,
+                             uint8_t *data,
+                             int *status,
+                             const sss_Share *shares,
+                             size_t count,
+                             uint8_t k)
+{
+	Job job;
+	int ret;
+
+	if (k < 1) return -1;
+	if (job_init(&job, pool, k, k) != 0) return -1;
+	job.data_out = data;
+	job.status = status;
+	job.shares = shares;
+	run(pool, combine_task, &job, count);
+	ret = job_failed(&job);
+	job_free(&job);
+	return ret;
+}
+
+
+void sss_create_shares_batch_ctx(sss_Threadpool *pool,
+                                 sss_Ctx **ctxs,
+                                 sss_Share *out,
+                                 const uint8_t *data,
+                                 size_t count,
+                                 uint8_t n,
+                                 uint8_t k)
+{
+	Job job;
+
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	job_init_ctx(&job, pool, ctxs, n, k);
+	job.out = out;
+	job.data = data;
+	run(pool, create_task, &job, count);
+}
+
+
+int sss_combine_shares_batch_ctx(sss_Threadpool *pool,
+                                 sss_Ctx **ctxs,
+                                 uint8_t *data,
+                                 int *status,
+                                 const sss_Share *shares,
+                                 size_t count,
+                                 uint8_t k)
+{
+	Job job;
+
+	if (k < 1) return -1;
+	job_init_ctx(&job, pool, ctxs, k, k);
+	job.data_out = data;
+	job.status = status;
+	job.shares = shares;
+	run(pool, combine_task, &job, count);
+	return job_failed(&job);
+}
+
+
+int sss_refresh_shares_batch(sss_Threadpool *pool,
+                             sss_Share *shares,
+                             size_t count,
+                             uint8_t n,
+                             uint8_t k)
+{
+	Job job;
+
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	if (job_init(&job, pool, n, k) != 0) return -1;
+	job.out = shares;
+	run(pool, refresh_task, &job, count);
+	job_free(&job);
+	return 0;
+}
+
+
+int sss_reshare_shares_batch(sss_Threadpool *pool,
+                             sss_Share *out,
+                             int *status,
+                             const sss_Share *shares,
+                             size_t count,
+                             uint8_t k,
+                             uint8_t n2,
+                             uint8_t k2)
+{
+	Job job;
+	int ret;
+
+	assert(k != 0);
+	assert(n2 != 0);
+	assert(k2 != 0);
+	assert(k2 <= n2);
+
+	if (job_init(&job, pool, n2, k > k2 ? k : k2) != 0) return -1;
+	job.k = k;
+	job.n2 = n2;
+	job.k2 = k2;
+	job.out = out;
+	job.status = status;
+	job.shares = shares;
+	run(pool, reshare_task, &job, count);
+	ret = job_failed(&job);
+	job_free(&job);
+	return ret;
+}
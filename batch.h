@@ -0,0 +1,136 @@
+/*
+ * Batch API for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * These functions create or combine the shares of many independent secrets
+ * in one call, spreading the secrets over the workers of a thread pool.
+ */
+
+
+#ifndef sss_BATCH_H_
+#define sss_BATCH_H_
+
+#include "sss.h"
+#include "threadpool.h"
+#include <stddef.h>
+
+
+/*
+ * Create `n` shares with a threshold of `k` for each of the `count` secrets
+ * in `data`, which holds `count * sss_MLEN` bytes.
+ *
+ * The shares of secret `i` are written to `out[i * n .. i * n + n - 1]`, so
+ * the caller has to guarantee that `out` fits at least `count * n` instances
+ * of `sss_Share`.
+ *
+ * If `pool` is NULL, all of the work is done on the calling thread.
+ *
+ * Returns 0 on success, and -1 if the scratch space could not be allocated
+ * (in which case no shares have been written).
+ */
+int sss_create_shares_batch(sss_Threadpool *pool,
+                            sss_Share *out,
+                            const uint8_t *data,
+                            size_t count,
+                            uint8_t n,
+                            uint8_t k);
+
+
+/*
+ * Combine `k` shares for each of the `count` secrets. The shares of secret `i`
+ * are read from `shares[i * k .. i * k + k - 1]` and the secret is written to
+ * `data[i * sss_MLEN .. (i + 1) * sss_MLEN - 1]`.
+ *
+ * If `status` is not NULL, the return value of `sss_combine_shares` for
+ * secret `i` is written to `status[i]`.
+ *
+ * If `pool` is NULL, all of the work is done on the calling thread.
+ *
+ * Returns 0 if all of the secrets were restored, and -1 if any of them
+ * failed or if the scratch space could not be allocated.
+ */
+int sss_combine_shares_batch(sss_Threadpool *pool,
+                             uint8_t *data,
+                             int *status,
+                             const sss_Share *shares,
+                             size_t count,
+                             uint8_t k);
+
+
+/*
+ * Same as `sss_create_shares_batch`, but with workspaces from the caller
+ * instead of fresh ones for every call. `ctxs` holds one workspace for every
+ * worker of `pool` (or one if `pool` is NULL), each of which must fit `n`
+ * and `k`. The workspaces keep their caches and buffered randomness from
+ * one call to the next, and may live in a secure arena (`sss_ctx_new_in`).
+ * They must not have a thread pool set (`sss_ctx_set_threadpool`).
+ */
+void sss_create_shares_batch_ctx(sss_Threadpool *pool,
+                                 sss_Ctx **ctxs,
+                                 sss_Share *out,
+                                 const uint8_t *data,
+                                 size_t count,
+                                 uint8_t n,
+                                 uint8_t k);
+
+
+/*
+ * Same as `sss_combine_shares_batch`, but with workspaces from the caller
+ * (see `sss_create_shares_batch_ctx`), each of which must fit `k`.
+ *
+ * Returns 0 if all of the secrets were restored, and -1 if any of them
+ * failed.
+ */
+int sss_combine_shares_batch_ctx(sss_Threadpool *pool,
+                                 sss_Ctx **ctxs,
+                                 uint8_t *data,
+                                 int *status,
+                                 const sss_Share *shares,
+                                 size_t count,
+                                 uint8_t k);
+
+
+/*
+ * Refresh the `n` shares (with a threshold of `k`) of each of the `count`
+ * secrets in place, without restoring any of the secrets. The shares of
+ * secret `i` are in `shares[i * n .. i * n + n - 1]`. See
+ * `sss_refresh_shares`.
+ *
+ * If `pool` is NULL, all of the work is done on the calling thread.
+ *
+ * Returns 0 on success, and -1 if the scratch space could not be allocated
+ * (in which case no shares have been changed).
+ */
+int sss_refresh_shares_batch(sss_Threadpool *pool,
+                             sss_Share *shares,
+                             size_t count,
+                             uint8_t n,
+                             uint8_t k);
+
+
+/*
+ * Move each of the `count` secrets from a policy with threshold `k` to a new
+ * policy with `n2` shares and a threshold of `k2`, without restoring any of
+ * the secrets. The `k` old shares of secret `i` are read from
+ * `shares[i * k .. i * k + k - 1]`, and the new shares are written to
+ * `out[i * n2 .. i * n2 + n2 - 1]`. See `sss_reshare_shares`.
+ *
+ * If `status` is not NULL, the return value of `sss_reshare_shares` for
+ * secret `i` is written to `status[i]`.
+ *
+ * If `pool` is NULL, all of the work is done on the calling thread.
+ *
+ * Returns 0 if all of the secrets were reshared, and -1 if any of them
+ * failed or if the scratch space could not be allocated.
+ */
+int sss_reshare_shares_batch(sss_Threadpool *pool,
+                             sss_Share *out,
+                             int *status,
+                             const sss_Share *shares,
+                             size_t count,
+                             uint8_t k,
+                             uint8_t n2,
+                             uint8_t k2);
+
+
+#endif /* sss_BATCH_H_ */
@@ -0,0 +1,256 @@
+/*
+ * Microbenchmarks for Daan Sprenkels' Shamir secret sharing library
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Usage: sss-bench [filter]
+ *
+ * Runs every benchmark whose name contains `filter` (default: all of them)
+ * and writes the results to stdout as JSON. Every benchmark is calibrated to
+ * take at least MIN_SAMPLE_NS per sample, and is then sampled SAMPLES times.
+ * The figures are the cost of a single call: the median, the 90th and 99th
+ * percentile and the minimum in nanoseconds, and the median in cycles where
+ * a cycle counter is available (`rdtsc` on x86).
+ *
+ * The create and combine functions are measured over a grid of `n` and `k`,
+ * and the stream primitives over a range of message lengths. The shares of
+ * `sss_create_shares` always hold `sss_MLEN` bytes, so to measure another
+ * message length, rebuild with `-Dsss_MLEN=...`.
+ *
+ * The field arithmetic and the bitslice transforms are internal to
+ * `hazmat.c`, so that file is compiled into this benchmark directly.
+ */
+
+#include "hazmat.c"
+
+#include "sss.h"
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_RDTSC 1
+#endif
+
+
+#define SAMPLES 101
+#define MIN_SAMPLE_NS 20000
+#define MAX_LEN 16384
+
+
+typedef struct {
+	uint8_t n, k;
+	size_t len;
+} Params;
+
+typedef void (*BenchFn)(const Params *params);
+
+
+/*
+ * Buffers for the benchmarks. These are global, so the compiler cannot
+ * remove the calls that write to them.
+ */
+static uint8_t key[32], data[sss_MLEN], buf[MAX_LEN], tag[16];
+static uint8_t nonce[8];
+static uint32_t planes_a[8], planes_b[8];
+static sss_Keyshare keyshares[256];
+static sss_Share shares[256];
+static const char *separator = "";
+
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static uint64_t now_cycles(void)
+{
+#ifdef HAVE_RDTSC
+	uint32_t lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return (uint64_t) hi << 32 | lo;
+#else
+	return 0;
+#endif
+}
+
+
+static void bench_gf256_mul(const Params *params)
+{
+	(void) params;
+	gf256_mul(planes_a, planes_a, planes_b);
+}
+
+
+static void bench_gf256_inv(const Params *params)
+{
+	(void) params;
+	gf256_inv(planes_a, planes_b);
+}
+
+
+static void bench_bitslice(const Params *params)
+{
+	(void) params;
+	bitslice(planes_a, key);
+}
+
+
+static void bench_unbitslice(const Params *params)
+{
+	(void) params;
+	unbitslice(key, planes_a);
+}
+
+
+static void bench_salsa20(const Params *params)
+{
+	crypto_stream_salsa20(buf, params->len, nonce, key);
+}
+
+
+static void bench_poly1305(const Params *params)
+{
+	crypto_onetimeauth(tag, buf, params->len, key);
+}
+
+
+static void bench_randombytes(const Params *params)
+{
+	randombytes(buf, params->len);
+}
+
+
+static void bench_create_keyshares(const Params *params)
+{
+	sss_create_keyshares(keyshares, key, params->n, params->k);
+}
+
+
+static void bench_combine_keyshares(const Params *params)
+{
+	sss_combine_keyshares(key, (const sss_Keyshare*) keyshares, params->k);
+}
+
+
+static void bench_create_shares(const Params *params)
+{
+	sss_create_shares(shares, data, params->n, params->k);
+}
+
+
+static void bench_combine_shares(const Params *params)
+{
+	sss_combine_shares(data, (const sss_Share*) shares, params->k);
+}
+
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+	return (x > y) - (x < y);
+}
+
+
+static void run(const char *filter, const char *name, BenchFn fn,
+                const Params *params)
+{
+	uint64_t ns[SAMPLES], cycles[SAMPLES], start, start_cycles;
+	size_t iters = 1, idx, sample;
+
+	if (filter != NULL && strstr(name, filter) == NULL) return;
+
+	/* Warm up, and find the amount of calls per sample */
+	for (;;) {
+		start = now_ns();
+		for (idx = 0; idx < iters; idx++) fn(params);
+		if (now_ns() - start >= MIN_SAMPLE_NS) break;
+		iters *= 2;
+	}
+
+	for (sample = 0; sample < SAMPLES; sample++) {
+		start = now_ns();
+		start_cycles = now_cycles();
+		for (idx = 0; idx < iters; idx++) fn(params);
+		cycles[sample] = (now_cycles() - start_cycles) / iters;
+		ns[sample] = (now_ns() - start) / iters;
+	}
+	qsort(ns, SAMPLES, sizeof(uint64_t), compare_u64);
+	qsort(cycles, SAMPLES, sizeof(uint64_t), compare_u64);
+
+	printf("%s\n    {\"name\": \"%s\", \"n\": %u, \"k\": %u, \"len\": %lu, "
+	       "\"iters\": %lu, \"median_ns\": %lu, \"p90_ns\": %lu, "
+	       "\"p99_ns\": %lu, \"min_ns\": %lu",
+	       separator, name, (unsigned) params->n, (unsigned) params->k,
+	       (unsigned long) params->len, (unsigned long) iters,
+	       (unsigned long) ns[SAMPLES / 2],
+	       (unsigned long) ns[SAMPLES * 90 / 100],
+	       (unsigned long) ns[SAMPLES * 99 / 100], (unsigned long) ns[0]);
+#ifdef HAVE_RDTSC
+	printf(", \"median_cycles\": %lu", (unsigned long) cycles[SAMPLES / 2]);
+#endif
+	printf("}");
+	fflush(stdout);
+	separator = ",";
+}
+
+
+int main(int argc, char *argv[])
+{
+	static const uint8_t grid_n[] = { 3, 5, 9, 16, 64, 255 };
+	static const size_t grid_len[] = { 64, 1024, MAX_LEN };
+	const char *filter = argc > 1 ? argv[1] : NULL;
+	Params params = { 0, 0, 0 };
+	uint8_t grid_k[3];
+	size_t idx1, idx2;
+
+	randombytes(key, sizeof(key));
+	randombytes(data, sizeof(data));
+	randombytes(planes_b, sizeof(planes_b));
+	randombytes(buf, sizeof(buf));
+
+	printf("{\n  \"mlen\": %lu,\n  \"timer\": \"%s\",\n  \"results\": [",
+	       (unsigned long) sss_MLEN,
+#ifdef HAVE_RDTSC
+	       "clock_gettime+rdtsc"
+#else
+	       "clock_gettime"
+#endif
+	       );
+
+	run(filter, "gf256_mul", bench_gf256_mul, &params);
+	run(filter, "gf256_inv", bench_gf256_inv, &params);
+	run(filter, "bitslice", bench_bitslice, &params);
+	run(filter, "unbitslice", bench_unbitslice, &params);
+	for (idx1 = 0; idx1 < sizeof(grid_len) / sizeof(grid_len[0]); idx1++) {
+		params.len = grid_len[idx1];
+		run(filter, "salsa20", bench_salsa20, &params);
+		run(filter, "poly1305", bench_poly1305, &params);
+		run(filter, "randombytes", bench_randombytes, &params);
+	}
+
+	params.len = sss_MLEN;
+	for (idx1 = 0; idx1 < sizeof(grid_n); idx1++) {
+		params.n = grid_n[idx1];
+		grid_k[0] = 2;
+		grid_k[1] = params.n / 2 + 1;
+		grid_k[2] = params.n;
+		for (idx2 = 0; idx2 < 3; idx2++) {
+			if (idx2 > 0 && grid_k[idx2] == grid_k[idx2 - 1]) continue;
+			params.k = grid_k[idx2];
+
+			/* The combine benchmarks use the shares from the create runs */
+			sss_create_keyshares(keyshares, key, params.n, params.k);
+			run(filter, "sss_create_keyshares", bench_create_keyshares, &params);
+			run(filter, "sss_combine_keyshares", bench_combine_keyshares,
+			    &params);
+			sss_create_shares(shares, data, params.n, params.k);
+			run(filter, "sss_create_shares", bench_create_shares, &params);
+			run(filter, "sss_combine_shares", bench_combine_shares, &params);
+		}
+	}
+	printf("\n  ]\n}\n");
+	return 0;
+}
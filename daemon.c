@@ -0,0 +1,519 @@
+/*
+ * sss-daemon: serve create and combine requests over a Unix domain socket
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Usage: sss-daemon [-j workers] [-b max_batch] [-d deadline_us] socket
+ *
+ * Every client connection is served by its own thread, which reads one
+ * request at a time and waits for the response. The requests of all of the
+ * connections are collected by a single batcher, which waits until it has
+ * `max_batch` requests (default: 256), or until the oldest request has waited
+ * for `deadline_us` microseconds (default: 100). It then runs all of the
+ * requests with the same parameters as one call to
+ * `sss_create_shares_batch_ctx` or `sss_combine_shares_batch_ctx` on a warm
+ * thread pool.
+ *
+ * The request and response buffers of every connection are taken from secure
+ * memory arenas (see `arena.h`). So are the scratch space of the batcher and
+ * the workspace of every worker, which are created once at startup and reused
+ * for every batch, so that the workspaces also keep their Lagrange caches and
+ * buffered randomness. All of the secrets stay in memory that is locked (if
+ * the platform allows it) and excluded from core dumps. The socket is only
+ * accessible to the user that runs the daemon.
+ *
+ * Protocol
+ * --------
+ *
+ * A request starts with 4 bytes: an opcode, `n`, `k` and a zero byte. A
+ * response starts with a status byte: 0 on success, 1 if the secret could
+ * not be restored and 2 for an invalid request (after which the daemon
+ * closes the connection). The rest of the messages depends on the opcode:
+ *
+ *     1 (create)   request:  sss_MLEN bytes of data
+ *                  response: `n` shares (if the status is 0)
+ *     2 (combine)  request:  `k` shares (`n` is ignored)
+ *                  response: sss_MLEN bytes of data (if the status is 0)
+ *     3 (stats)    request:  nothing (`n` and `k` are ignored)
+ *                  response: STATS_LEN counters of 8 bytes (little endian),
+ *                            in the order of `Stats`
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "arena.h"
+#include "batch.h"
+#include "sss.h"
+#include "threadpool.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define OP_CREATE 1
+#define OP_COMBINE 2
+#define OP_STATS 3
+
+#define STATUS_OK 0
+#define STATUS_FAILED 1
+#define STATUS_INVALID 2
+
+#define MAX_BATCH 1024
+
+/*
+ * Amount of shares in the scratch space of the batcher. Larger groups of
+ * requests are split into multiple batches.
+ */
+#define SCRATCH_SHARES 4096
+
+/*
+ * Largest payload of a request or a response
+ */
+#define MAX_PAYLOAD (255 * sss_SHARE_LEN)
+
+/*
+ * Amount of latency histogram buckets. Bucket `i` counts the requests that
+ * took less than 2^(i+1) microseconds (the last bucket counts the rest).
+ */
+#define LATENCY_BUCKETS 16
+
+
+/*
+ * The counters that are returned by a stats request
+ */
+typedef struct {
+	uint64_t creates, combines, failures, invalid;
+	uint64_t batches, batched;
+	uint64_t latency_total_ns, latency_max_ns;
+	uint64_t latency[LATENCY_BUCKETS];
+} Stats;
+
+#define STATS_LEN (sizeof(Stats) / sizeof(uint64_t))
+
+
+/*
+ * A request that is waiting for the batcher. It lives on the stack of the
+ * connection thread that waits for it.
+ */
+typedef struct Request {
+	struct Request *next;
+	uint8_t op, n, k, status;
+	const uint8_t *in;
+	uint8_t *out;
+	struct timespec arrival;
+	int taken, done;
+} Request;
+
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t pending_cond, done_cond;
+	Request *pending, **pending_tail;
+	size_t pending_len, max_batch;
+	long deadline_us;
+	Stats stats;
+
+	/* Only used by the batcher */
+	sss_Threadpool *pool;
+	sss_Ctx *ctxs[sss_THREADPOOL_MAX];
+	uint8_t (*data)[sss_MLEN];
+	sss_Share *shares;
+	int status[MAX_BATCH];
+} Daemon;
+
+
+typedef struct {
+	Daemon *daemon;
+	int fd;
+} Connection;
+
+
+static int read_all(int fd, uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = read(fd, buf, len);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret <= 0) return -1;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret < 0) return -1;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+
+static uint64_t elapsed_ns(const struct timespec *start,
+                           const struct timespec *end)
+{
+	return (uint64_t) (end->tv_sec - start->tv_sec) * 1000000000 +
+	       end->tv_nsec - start->tv_nsec;
+}
+
+
+/*
+ * Run the requests in `group` (which all have the same parameters) as one
+ * batch
+ */
+static void run_group(Daemon *daemon, Request **group, size_t len)
+{
+	uint8_t n = group[0]->n, k = group[0]->k;
+	size_t idx;
+
+	if (group[0]->op == OP_CREATE) {
+		for (idx = 0; idx < len; idx++) {
+			memcpy(daemon->data[idx], group[idx]->in, sss_MLEN);
+		}
+		sss_create_shares_batch_ctx(daemon->pool, daemon->ctxs,
+		                            daemon->shares,
+		                            (const uint8_t*) daemon->data,
+		                            len, n, k);
+		for (idx = 0; idx < len; idx++) {
+			memcpy(group[idx]->out, daemon->shares[idx * n],
+			       n * sizeof(sss_Share));
+			group[idx]->status = STATUS_OK;
+		}
+		sss_memzero(daemon->shares, len * n * sizeof(sss_Share));
+	} else {
+		for (idx = 0; idx < len; idx++) {
+			memcpy(daemon->shares[idx * k], group[idx]->in,
+			       k * sizeof(sss_Share));
+		}
+		sss_combine_shares_batch_ctx(daemon->pool, daemon->ctxs,
+		                             (uint8_t*) daemon->data, daemon->status,
+		                             (const sss_Share*) daemon->shares,
+		                             len, k);
+		for (idx = 0; idx < len; idx++) {
+			memcpy(group[idx]->out, daemon->data[idx], sss_MLEN);
+			group[idx]->status = daemon->status[idx] == 0 ? STATUS_OK
+			                                              : STATUS_FAILED;
+		}
+		sss_memzero(daemon->shares, len * k * sizeof(sss_Share));
+	}
+	sss_memzero(daemon->data, len * sss_MLEN);
+}
+
+
+/*
+ * Run all of the requests in `list`, grouped by their parameters
+ */
+static void run_batch(Daemon *daemon, Request *list)
+{
+	Request *req, *other, *group[MAX_BATCH];
+	size_t len, per_req;
+
+	for (req = list; req != NULL; req = req->next) req->taken = 0;
+	for (req = list; req != NULL; req = req->next) {
+		if (req->taken) continue;
+		per_req = req->op == OP_CREATE ? req->n : req->k;
+		len = 0;
+		for (other = req; other != NULL; other = other->next) {
+			if (other->taken || other->op != req->op ||
+			    other->n != req->n || other->k != req->k) {
+				continue;
+			}
+			if (len == MAX_BATCH || (len + 1) * per_req > SCRATCH_SHARES) {
+				break;
+			}
+			other->taken = 1;
+			group[len++] = other;
+		}
+		run_group(daemon, group, len);
+	}
+}
+
+
+static void* run_batcher(void *arg)
+{
+	Daemon *daemon = arg;
+	struct timespec deadline, now;
+	Request *list, *req;
+	uint64_t latency, us;
+	size_t bucket, len;
+
+	pthread_mutex_lock(&daemon->lock);
+	for (;;) {
+		while (daemon->pending == NULL) {
+			pthread_cond_wait(&daemon->pending_cond, &daemon->lock);
+		}
+
+		/* Wait for a full batch, or for the deadline of the oldest request */
+		deadline = daemon->pending->arrival;
+		deadline.tv_nsec += daemon->deadline_us * 1000;
+		deadline.tv_sec += deadline.tv_nsec / 1000000000;
+		deadline.tv_nsec %= 1000000000;
+		while (daemon->pending_len < daemon->max_batch) {
+			if (pthread_cond_timedwait(&daemon->pending_cond, &daemon->lock,
+			                           &deadline) == ETIMEDOUT) {
+				break;
+			}
+		}
+
+		list = daemon->pending;
+		len = daemon->pending_len;
+		daemon->pending = NULL;
+		daemon->pending_tail = &daemon->pending;
+		daemon->pending_len = 0;
+		pthread_mutex_unlock(&daemon->lock);
+
+		run_batch(daemon, list);
+
+		pthread_mutex_lock(&daemon->lock);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		daemon->stats.batches++;
+		daemon->stats.batched += len;
+		for (req = list; req != NULL; req = req->next) {
+			if (req->op == OP_CREATE) daemon->stats.creates++;
+			else daemon->stats.combines++;
+			if (req->status != STATUS_OK) daemon->stats.failures++;
+			latency = elapsed_ns(&req->arrival, &now);
+			daemon->stats.latency_total_ns += latency;
+			if (latency > daemon->stats.latency_max_ns) {
+				daemon->stats.latency_max_ns = latency;
+			}
+			us = latency / 1000;
+			for (bucket = 0; bucket < LATENCY_BUCKETS - 1 && us >= 2; bucket++) {
+				us >>= 1;
+			}
+			daemon->stats.latency[bucket]++;
+			req->done = 1;
+		}
+		pthread_cond_broadcast(&daemon->done_cond);
+	}
+	return NULL;
+}
+
+
+/*
+ * Hand `req` to the batcher and wait until it is done
+ */
+static void submit(Daemon *daemon, Request *req)
+{
+	clock_gettime(CLOCK_MONOTONIC, &req->arrival);
+	req->next = NULL;
+	req->done = 0;
+	pthread_mutex_lock(&daemon->lock);
+	*daemon->pending_tail = req;
+	daemon->pending_tail = &req->next;
+	daemon->pending_len++;
+	if (daemon->pending_len == 1 ||
+	    daemon->pending_len >= daemon->max_batch) {
+		pthread_cond_signal(&daemon->pending_cond);
+	}
+	while (!req->done) pthread_cond_wait(&daemon->done_cond, &daemon->lock);
+	pthread_mutex_unlock(&daemon->lock);
+}
+
+
+/*
+ * Serve one request on `conn`. Returns -1 if the connection should be
+ * closed.
+ */
+static int serve_request(Connection *conn, uint8_t *in, uint8_t *out)
+{
+	Daemon *daemon = conn->daemon;
+	uint8_t header[4];
+	Request req;
+	Stats stats;
+	size_t in_len, out_len, idx, byte;
+	const uint64_t *counters = (const uint64_t*) &stats;
+
+	if (read_all(conn->fd, header, sizeof(header)) != 0) return -1;
+	req.op = header[0];
+	req.n = header[1];
+	req.k = header[2];
+	req.in = in;
+	req.out = &out[1];
+
+	switch (req.op) {
+	case OP_CREATE:
+		if (req.k == 0 || req.k > req.n || header[3] != 0) goto invalid;
+		in_len = sss_MLEN;
+		out_len = req.n * sizeof(sss_Share);
+		break;
+	case OP_COMBINE:
+		if (req.k == 0 || header[3] != 0) goto invalid;
+		req.n = 0;
+		in_len = req.k * sizeof(sss_Share);
+		out_len = sss_MLEN;
+		break;
+	case OP_STATS:
+		pthread_mutex_lock(&daemon->lock);
+		stats = daemon->stats;
+		pthread_mutex_unlock(&daemon->lock);
+		out[0] = STATUS_OK;
+		for (idx = 0; idx < STATS_LEN; idx++) {
+			for (byte = 0; byte < 8; byte++) {
+				out[1 + 8 * idx + byte] = counters[idx] >> (8 * byte);
+			}
+		}
+		return write_all(conn->fd, out, 1 + 8 * STATS_LEN);
+	default:
+		goto invalid;
+	}
+
+	if (read_all(conn->fd, in, in_len) != 0) return -1;
+	submit(daemon, &req);
+	out[0] = req.status;
+	if (req.status != STATUS_OK) out_len = 0;
+	if (write_all(conn->fd, out, 1 + out_len) != 0) return -1;
+	sss_memzero(in, in_len);
+	sss_memzero(out, 1 + out_len);
+	return 0;
+
+invalid:
+	pthread_mutex_lock(&daemon->lock);
+	daemon->stats.invalid++;
+	pthread_mutex_unlock(&daemon->lock);
+	out[0] = STATUS_INVALID;
+	(void) write_all(conn->fd, out, 1);
+	return -1;
+}
+
+
+static void* serve_connection(void *arg)
+{
+	Connection *conn = arg;
+	sss_Arena *arena;
+	uint8_t *in, *out;
+
+	arena = sss_arena_new(2 * (1 + MAX_PAYLOAD));
+	if (arena != NULL) {
+		in = sss_arena_alloc(arena, MAX_PAYLOAD);
+		out = sss_arena_alloc(arena, 1 + MAX_PAYLOAD);
+		while (serve_request(conn, in, out) == 0) {}
+		sss_arena_free(arena);
+	}
+	close(conn->fd);
+	free(conn);
+	return NULL;
+}
+
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: sss-daemon [-j workers] [-b max_batch] "
+	        "[-d deadline_us] socket\n");
+	exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+	static Daemon daemon;
+	struct sockaddr_un addr;
+	pthread_condattr_t cond_attr;
+	sss_Arena *scratch;
+	Connection *conn;
+	pthread_t thread;
+	long nworkers = sysconf(_SC_NPROCESSORS_ONLN), max_batch = 256;
+	long deadline_us = 100;
+	size_t idx, workers;
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "j:b:d:")) != -1) {
+		switch (opt) {
+		case 'j':
+			nworkers = strtol(optarg, NULL, 10);
+			if (nworkers < 1) usage();
+			break;
+		case 'b':
+			max_batch = strtol(optarg, NULL, 10);
+			if (max_batch < 1 || max_batch > MAX_BATCH) usage();
+			break;
+		case 'd':
+			deadline_us = strtol(optarg, NULL, 10);
+			if (deadline_us < 0 || deadline_us > 1000000) usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc - optind != 1) usage();
+	if (strlen(argv[optind]) >= sizeof(addr.sun_path)) usage();
+	if (nworkers < 1) nworkers = 1;
+
+	/* The deadlines are computed from the (monotonic) arrival times */
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&daemon.lock, NULL);
+	pthread_cond_init(&daemon.pending_cond, &cond_attr);
+	pthread_cond_init(&daemon.done_cond, NULL);
+	daemon.pending_tail = &daemon.pending;
+	daemon.max_batch = max_batch;
+	daemon.deadline_us = deadline_us;
+	daemon.pool = nworkers > 1 ? sss_threadpool_new(nworkers) : NULL;
+	workers = daemon.pool != NULL ? sss_threadpool_size(daemon.pool) : 1;
+	scratch = sss_arena_new(MAX_BATCH * sss_MLEN +
+	                        SCRATCH_SHARES * sizeof(sss_Share) +
+	                        workers * sss_ctx_arena_size(255, 255));
+	if ((nworkers > 1 && daemon.pool == NULL) || scratch == NULL) {
+		fprintf(stderr, "sss-daemon: out of memory\n");
+		return 1;
+	}
+	if (!sss_arena_locked(scratch)) {
+		fprintf(stderr, "sss-daemon: warning: could not lock memory\n");
+	}
+	daemon.data = sss_arena_alloc(scratch, MAX_BATCH * sss_MLEN);
+	daemon.shares = sss_arena_alloc(scratch, SCRATCH_SHARES * sizeof(sss_Share));
+	for (idx = 0; idx < workers; idx++) {
+		daemon.ctxs[idx] = sss_ctx_new_in(scratch, 255, 255);
+		if (daemon.ctxs[idx] == NULL) {
+			fprintf(stderr, "sss-daemon: out of memory\n");
+			return 1;
+		}
+		sss_ctx_buffer_randomness(daemon.ctxs[idx], 1);
+	}
+
+	/* Only the current user may connect */
+	umask(077);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, argv[optind]);
+	unlink(addr.sun_path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+	    listen(fd, 64) != 0) {
+		fprintf(stderr, "sss-daemon: %s: could not listen\n", addr.sun_path);
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	if (pthread_create(&thread, NULL, run_batcher, &daemon) != 0) return 1;
+	for (;;) {
+		conn = malloc(sizeof(*conn));
+		if (conn == NULL) return 1;
+		conn->daemon = &daemon;
+		conn->fd = accept(fd, NULL, NULL);
+		if (conn->fd < 0 ||
+		    pthread_create(&thread, NULL, serve_connection, conn) != 0) {
+			if (conn->fd >= 0) close(conn->fd);
+			free(conn);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * Code generator for the specialized (n, k) policies in `hazmat.c`
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Usage: gen_policies N:K [N:K ...] > policies.h
+ *
+ * For every policy, this writes the Lagrange weights (evaluated at x = 0) for
+ * every set of `k` x values from 1..n, so that combining shares that were
+ * created under one of these policies does not have to compute any weights.
+ * The weights of set `mask` (bit `x - 1` is set for every x value in the set)
+ * are in `policy_weights_N_K[mask]`, where the weight for the share with x
+ * value `x` is at index `x - 1`.
+ *
+ * The x values are public, so this does not have to be constant time.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * Largest `n` for which we generate a table (the tables have 2^n rows)
+ */
+#define MAX_N 10
+
+
+static unsigned gf256_mul(unsigned a, unsigned b)
+{
+	unsigned r = 0;
+
+	while (b != 0) {
+		if (b & 1) r ^= a;
+		a <<= 1;
+		if (a & 0x100) a ^= 0x11B;
+		b >>= 1;
+	}
+	return r;
+}
+
+
+static unsigned gf256_inv(unsigned x)
+{
+	unsigned r;
+
+	for (r = 1; r < 256; r++) {
+		if (gf256_mul(x, r) == 1) return r;
+	}
+	return 0;
+}
+
+
+static int popcount(unsigned x)
+{
+	int r = 0;
+	for (; x != 0; x >>= 1) r += x & 1;
+	return r;
+}
+
+
+static void write_table(unsigned n, unsigned k)
+{
+	unsigned mask, x1, x2, num, denom;
+
+	printf("static const uint8_t policy_weights_%u_%u[%u][%u] = {\n",
+	       n, k, 1u << n, n);
+	for (mask = 0; mask < (1u << n); mask++) {
+		printf("\t{");
+		for (x1 = 1; x1 <= n; x1++) {
+			num = 0;
+			if (popcount(mask) == (int) k && (mask >> (x1 - 1) & 1)) {
+				num = 1;
+				denom = 1;
+				for (x2 = 1; x2 <= n; x2++) {
+					if (x1 == x2 || !(mask >> (x2 - 1) & 1)) continue;
+					num = gf256_mul(num, x2);
+					denom = gf256_mul(denom, x1 ^ x2);
+				}
+				num = gf256_mul(num, gf256_inv(denom));
+			}
+			printf(" 0x%02X%s", num, x1 < n ? "," : "");
+		}
+		printf(" },\n");
+	}
+	printf("};\n\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+	unsigned n[64], k[64];
+	int idx;
+
+	if (argc - 1 > 64) {
+		fprintf(stderr, "gen_policies: too many policies\n");
+		return 1;
+	}
+	for (idx = 1; idx < argc; idx++) {
+		if (sscanf(argv[idx], "%u:%u", &n[idx - 1], &k[idx - 1]) != 2 ||
+		    k[idx - 1] < 2 || k[idx - 1] > n[idx - 1] ||
+		    n[idx - 1] > MAX_N) {
+			fprintf(stderr, "gen_policies: invalid policy '%s' "
+			        "(need 2 <= k <= n <= %d)\n", argv[idx], MAX_N);
+			return 1;
+		}
+	}
+
+	printf("/* Generated by gen_policies.c, do not edit */\n\n");
+	printf("#define sss_POLICIES(X)");
+	for (idx = 0; idx < argc - 1; idx++) {
+		printf(" \\\n\tX(%u, %u)", n[idx], k[idx]);
+	}
+	printf("\n\n");
+	for (idx = 0; idx < argc - 1; idx++) write_table(n[idx], k[idx]);
+	return 0;
+}
@@ -18,9 +18,17 @@
  */
 
 
+#define _POSIX_C_SOURCE 200112L
+
 #include "randombytes.h"
+#include "tweetnacl.h"
+#include "arena.h"
 #include "hazmat.h"
+#include "policies.h"
+#include "probes.h"
+#include "stats.h"
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -35,6 +43,7 @@ bitslice(uint32_t r[8], const uint8_t x[32])
 {
 	size_t bit_idx, arr_idx;
 	uint32_t cur;
+	sss_STATS_START(start);
 
 	memset(r, 0, sizeof(uint32_t[8]));
 	for (arr_idx = 0; arr_idx < 32; arr_idx++) {
@@ -43,6 +52,7 @@ bitslice(uint32_t r[8], const uint8_t x[32])
 			r[bit_idx] |= ((cur >> bit_idx) & 1) << arr_idx;
 		}
 	}
+	sss_STATS_PHASE(transpose_ticks, start);
 }
 
 
@@ -51,6 +61,7 @@ unbitslice(uint8_t r[32], const uint32_t x[8])
 {
 	size_t bit_idx, arr_idx;
 	uint32_t cur;
+	sss_STATS_START(start);
 
 	memset(r, 0, sizeof(uint8_t[32]));
 	for (bit_idx = 0; bit_idx < 8; bit_idx++) {
@@ -59,6 +70,7 @@ unbitslice(uint8_t r[32], const uint32_t x[8])
 			r[arr_idx] |= ((cur >> arr_idx) & 1) << bit_idx;
 		}
 	}
+	sss_STATS_PHASE(transpose_ticks, start);
 }
 
 
@@ -102,6 +114,7 @@ gf256_mul(uint32_t r[8], const uint32_t a[8], const uint32_t b[8])
 	 * loops. So we will just have to do this by hand.
 	 */
 	uint32_t a2[8];
+	sss_STATS_ADD(gf256_muls, 1);
 	memcpy(a2, a, sizeof(uint32_t[8]));
 
 	r[0] = a2[0] & b[0]; /* add (assignment, because r is 0) */
@@ -252,6 +265,7 @@ gf256_inv(uint32_t r[8], uint32_t x[8])
 {
 	uint32_t y[8], z[8];
 
+	sss_STATS_ADD(gf256_invs, 1);
 	gf256_square(y, x); // y = x^2
 	gf256_square(y, y); // y = x^4
 	gf256_square(r, y); // r = x^8
@@ -266,6 +280,169 @@ gf256_inv(uint32_t r[8], uint32_t x[8])
 }
 
 
+/*
+ * Evaluate the polynomial with constant term `poly0` and the `k-1` other
+ * terms in `poly` at the x values `begin+1..end` and write the resulting key
+ * shares to `out[begin..end-1]`.
+ */
+static void
+eval_keyshares(sss_Keyshare *out,
+               const uint32_t poly0[8],
+               const uint32_t poly[][8],
+               size_t begin,
+               size_t end,
+               uint8_t k)
+{
+	size_t share_idx;
+	uint8_t coeff_idx, unbitsliced_x;
+	uint32_t x[8], y[8], xpow[8], tmp[8];
+
+	for (share_idx = begin; share_idx < end; share_idx++) {
+		/* x value is in 1..n */
+		unbitsliced_x = share_idx + 1;
+		out[share_idx][0] = unbitsliced_x;
+		bitslice_setall(x, unbitsliced_x);
+
+		/* Calculate y */
+		memset(y, 0, sizeof(y));
+		memset(xpow, 0, sizeof(xpow));
+		xpow[0] = ~0;
+		gf256_add(y, poly0);
+		for (coeff_idx = 0; coeff_idx < (k-1); coeff_idx++) {
+			gf256_mul(xpow, xpow, x);
+			gf256_mul(tmp, xpow, poly[coeff_idx]);
+			gf256_add(y, tmp);
+		}
+		unbitslice(&out[share_idx][1], y);
+	}
+	sss_memzero(y, sizeof(y));
+	sss_memzero(tmp, sizeof(tmp));
+}
+
+
+/*
+ * Specialized create and combine functions for the policies in
+ * `policies.h`, which is generated by `gen_policies.c` from the `POLICIES`
+ * variable in the Makefile.
+ *
+ * Because `n` and `k` are constants here, all of the buffers have a fixed
+ * size and the compiler unrolls all of the loops. When combining, the
+ * Lagrange weights for the x values are looked up in the generated table.
+ */
+#define DEFINE_POLICY(N, K)                                                   \
+static void                                                                   \
+create_keyshares_##N##_##K(sss_Keyshare *out, const uint8_t key[32])          \
+{                                                                             \
+	size_t share_idx, coeff_idx;                                          \
+	uint32_t poly0[8], poly[K - 1][8], x[8], y[8];                        \
+                                                                              \
+	bitslice(poly0, key);                                                 \
+	sss_STATS_START(start);                                               \
+	randombytes((void*) poly, sizeof(poly));                              \
+	sss_STATS_PHASE(randomness_ticks, start);                             \
+	for (share_idx = 0; share_idx < N; share_idx++) {                     \
+		bitslice_setall(x, share_idx + 1);                            \
+		memcpy(y, poly[K - 2], sizeof(y));                            \
+		for (coeff_idx = K - 2; coeff_idx > 0; coeff_idx--) {         \
+			gf256_mul(y, y, x);                                   \
+			gf256_add(y, poly[coeff_idx - 1]);                    \
+		}                                                             \
+		gf256_mul(y, y, x);                                           \
+		gf256_add(y, poly0);                                          \
+		out[share_idx][0] = share_idx + 1;                            \
+		unbitslice(&out[share_idx][1], y);                            \
+	}                                                                     \
+	sss_memzero(poly0, sizeof(poly0));                                    \
+	sss_memzero(poly, sizeof(poly));                                      \
+	sss_memzero(y, sizeof(y));                                            \
+}                                                                             \
+                                                                              \
+static void                                                                   \
+combine_keyshares_##N##_##K(uint8_t key[32],                                  \
+                            const sss_Keyshare *shares,                       \
+                            const uint8_t weights[N])                         \
+{                                                                             \
+	size_t share_idx;                                                     \
+	uint32_t w[8], y[8], secret[8] = { 0 };                               \
+                                                                              \
+	for (share_idx = 0; share_idx < K; share_idx++) {                     \
+		bitslice_setall(w, weights[shares[share_idx][0] - 1]);        \
+		bitslice(y, &shares[share_idx][1]);                           \
+		gf256_mul(y, y, w);                                           \
+		gf256_add(secret, y);                                         \
+	}                                                                     \
+	unbitslice(key, secret);                                              \
+	sss_memzero(y, sizeof(y));                                            \
+	sss_memzero(secret, sizeof(secret));                                  \
+}
+
+sss_POLICIES(DEFINE_POLICY)
+
+
+/*
+ * Use a specialized function to create the shares, if there is one for this
+ * policy. Returns 1 if the shares were created.
+ */
+static int
+create_keyshares_policy(sss_Keyshare *out,
+                        const uint8_t key[32],
+                        uint8_t n,
+                        uint8_t k)
+{
+#define CREATE_POLICY(N, K)                                                   \
+	if (n == N && k == K) {                                               \
+		create_keyshares_##N##_##K(out, key);                         \
+		return 1;                                                     \
+	}
+	sss_POLICIES(CREATE_POLICY)
+#undef CREATE_POLICY
+	(void) out;
+	(void) key;
+	(void) n;
+	(void) k;
+	return 0;
+}
+
+
+/*
+ * Use a specialized function to combine the shares, if their x values are
+ * all different and fit one of the policies with this `k`. (The x values are
+ * public, so we may branch on them.) Returns 1 if the key was restored.
+ */
+static int
+combine_keyshares_policy(uint8_t key[32],
+                         const sss_Keyshare *shares,
+                         uint8_t k)
+{
+	size_t share_idx;
+	unsigned long mask = 0;
+	uint8_t max_x = 0;
+
+	for (share_idx = 0; share_idx < k; share_idx++) {
+		if (shares[share_idx][0] == 0 ||
+		    shares[share_idx][0] > 8 * sizeof(mask)) {
+			return 0;
+		}
+		mask |= 1UL << (shares[share_idx][0] - 1);
+		if (shares[share_idx][0] > max_x) max_x = shares[share_idx][0];
+	}
+
+#define COMBINE_POLICY(N, K)                                                  \
+	if (k == K && max_x <= N &&                                           \
+	    policy_weights_##N##_##K[mask][shares[0][0] - 1] != 0) {          \
+		combine_keyshares_##N##_##K(key, shares,                      \
+		                            policy_weights_##N##_##K[mask]);  \
+		return 1;                                                     \
+	}
+	sss_POLICIES(COMBINE_POLICY)
+#undef COMBINE_POLICY
+	(void) key;
+	(void) mask;
+	(void) max_x;
+	return 0;
+}
+
+
 /*
  * Create `k` key shares of the key given in `key`. The caller has to ensure
  * that the array `out` has enough space to hold at least `n` sss_Keyshare
@@ -282,33 +459,181 @@ gf256_inv(uint32_t r[8], uint32_t x[8])
 	assert(k != 0);
 	assert(k <= n);
 
-	uint8_t share_idx, coeff_idx, unbitsliced_x;
-	uint32_t poly0[8], poly[k-1][8], x[8], y[8], xpow[8], tmp[8];
+	sss_PROBE2(create_keyshares__entry, n, k);
+	sss_STATS_ADD(create_keyshares_calls, 1);
+	sss_STATS_START(start);
+	if (create_keyshares_policy(out, key, n, k)) {
+		sss_STATS_PHASE(keyshare_create_ticks, start);
+		sss_PROBE2(create_keyshares__return, n, k);
+		return;
+	}
+
+	uint32_t poly0[8], poly[k-1][8];
 
 	/* Put the secret in the bottom part of the polynomial */
 	bitslice(poly0, key);
 
 	/* Generate the other terms of the polynomial */
+	sss_STATS_START(random_start);
+	randombytes((void*) poly, sizeof(poly));
+	sss_STATS_PHASE(randomness_ticks, random_start);
+
+	eval_keyshares(out, poly0, (const uint32_t (*)[8]) poly, 0, n, k);
+	sss_memzero(poly0, sizeof(poly0));
+	sss_memzero(poly, sizeof(poly));
+	sss_STATS_PHASE(keyshare_create_ticks, start);
+	sss_PROBE2(create_keyshares__return, n, k);
+}
+
+
+/*
+ * Create `n` key shares of a random polynomial with a zero constant term.
+ * This is the secret-independent part of `sss_create_keyshares`.
+ */
+void
+sss_precompute_keyshares(sss_Keyshare *out, uint8_t n, uint8_t k)
+{
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	uint32_t poly0[8] = { 0 }, poly[k-1][8];
+
 	randombytes((void*) poly, sizeof(poly));
+	eval_keyshares(out, poly0, (const uint32_t (*)[8]) poly, 0, n, k);
+	sss_memzero(poly, sizeof(poly));
+}
+
+
+/*
+ * Add `key` to the `n` precomputed key shares in `shares`.
+ *
+ * Bitslicing is linear, so adding the bitsliced key to every bitsliced y
+ * value is the same as XOR'ing the key bytes into every unbitsliced y value.
+ */
+void
+sss_apply_keyshares(sss_Keyshare *shares, const uint8_t key[32], uint8_t n)
+{
+	size_t share_idx, idx;
 
 	for (share_idx = 0; share_idx < n; share_idx++) {
-		/* x value is in 1..n */
-		unbitsliced_x = share_idx + 1;
-		out[share_idx][0] = unbitsliced_x;
-		bitslice_setall(x, unbitsliced_x);
+		for (idx = 0; idx < 32; idx++) {
+			shares[share_idx][1 + idx] ^= key[idx];
+		}
+	}
+}
 
-		/* Calculate y */
-		memset(y, 0, sizeof(y));
-		memset(xpow, 0, sizeof(xpow));
-		xpow[0] = ~0;
-		gf256_add(y, poly0);
-		for (coeff_idx = 0; coeff_idx < (k-1); coeff_idx++) {
-			gf256_mul(xpow, xpow, x);
-			gf256_mul(tmp, xpow, poly[coeff_idx]);
-			gf256_add(y, tmp);
+
+/*
+ * Shamir sharing is linear: if `a` and `b` are shares of two keys with the
+ * same x values, then `c * a + d * b` are shares of `c * key_a + d * key_b`
+ * (with the threshold of `a` and `b`). The functions below only look at the
+ * x values to check that they match, and treat all y values as secret.
+ */
+int
+sss_add_keyshares(sss_Keyshare *out,
+                  const sss_Keyshare *a,
+                  const sss_Keyshare *b,
+                  size_t n)
+{
+	size_t share_idx, idx;
+
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		if (a[share_idx][0] != b[share_idx][0]) return -1;
+	}
+
+	/* Addition is XOR, also when unbitsliced */
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		out[share_idx][0] = a[share_idx][0];
+		for (idx = 1; idx < sizeof(sss_Keyshare); idx++) {
+			out[share_idx][idx] = a[share_idx][idx] ^ b[share_idx][idx];
 		}
+	}
+	return 0;
+}
+
+
+void
+sss_scale_keyshares(sss_Keyshare *out,
+                    const sss_Keyshare *shares,
+                    uint8_t c,
+                    size_t n)
+{
+	size_t share_idx;
+	uint32_t cs[8], y[8];
+
+	bitslice_setall(cs, c);
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		bitslice(y, &shares[share_idx][1]);
+		gf256_mul(y, y, cs);
+		out[share_idx][0] = shares[share_idx][0];
 		unbitslice(&out[share_idx][1], y);
 	}
+	sss_memzero(y, sizeof(y));
+}
+
+
+int
+sss_linear_combine_keyshares(sss_Keyshare *out,
+                             const sss_Keyshare *const *sharings,
+                             const uint8_t *coeffs,
+                             size_t m,
+                             size_t n)
+{
+	size_t share_idx, idx;
+	uint32_t c[8], y[8], sum[8];
+
+	if (m == 0) return -1;
+
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		for (idx = 1; idx < m; idx++) {
+			if (sharings[idx][share_idx][0] != sharings[0][share_idx][0]) {
+				return -1;
+			}
+		}
+	}
+
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		memset(sum, 0, sizeof(sum));
+		for (idx = 0; idx < m; idx++) {
+			/* Broadcasting a coefficient is cheap, so it is not cached */
+			bitslice_setall(c, coeffs[idx]);
+			bitslice(y, &sharings[idx][share_idx][1]);
+			gf256_mul(y, y, c);
+			gf256_add(sum, y);
+		}
+		out[share_idx][0] = sharings[0][share_idx][0];
+		unbitslice(&out[share_idx][1], sum);
+	}
+	sss_memzero(y, sizeof(y));
+	sss_memzero(sum, sizeof(sum));
+	return 0;
+}
+
+
+/*
+ * Compute the Lagrange basis polynomial for the share with index `idx1`,
+ * evaluated at x = 0, and write it to `r`.
+ */
+static void
+lagrange_weight(uint32_t r[8], const uint32_t xs[][8], uint8_t k, size_t idx1)
+{
+	size_t idx2;
+	uint32_t denom[8], tmp[8];
+
+	memset(r, 0, sizeof(uint32_t[8]));
+	memset(denom, 0, sizeof(denom));
+	r[0] = ~0; /* r is the numerator (=1) */
+	denom[0] = ~0; /* denom is the numerator (=1) */
+	for (idx2 = 0; idx2 < k; idx2++) {
+		if (idx1 == idx2) continue;
+		gf256_mul(r, r, xs[idx2]);
+		memcpy(tmp, xs[idx1], sizeof(uint32_t[8]));
+		gf256_add(tmp, xs[idx2]);
+		gf256_mul(denom, denom, tmp);
+	}
+	gf256_inv(tmp, denom); /* inverted denominator */
+	gf256_mul(r, r, tmp); /* basis polynomial */
 }
 
 
@@ -320,11 +645,20 @@ gf256_inv(uint32_t r[8], uint32_t x[8])
                             const sss_Keyshare *key_shares,
                             uint8_t k)
 {
-	size_t share_idx, idx1, idx2;
+	size_t share_idx, idx1;
 	uint32_t xs[k][8], ys[k][8];
-	uint32_t num[8], denom[8], tmp[8];
+	uint32_t num[8];
 	uint32_t secret[8] = {0};
 
+	sss_PROBE1(combine_keyshares__entry, k);
+	sss_STATS_ADD(combine_keyshares_calls, 1);
+	sss_STATS_START(start);
+	if (combine_keyshares_policy(key, key_shares, k)) {
+		sss_STATS_PHASE(keyshare_combine_ticks, start);
+		sss_PROBE1(combine_keyshares__return, k);
+		return;
+	}
+
 	/* Collect the x and y values */
 	for (share_idx = 0; share_idx < k; share_idx++) {
 		bitslice_setall(xs[share_idx], key_shares[share_idx][0]);
@@ -333,21 +667,1433 @@ gf256_inv(uint32_t r[8], uint32_t x[8])
 
 	/* Use Lagrange basis polynomials to calculate the secret coefficient */
 	for (idx1 = 0; idx1 < k; idx1++) {
-		memset(num, 0, sizeof(num));
-		memset(denom, 0, sizeof(denom));
-		num[0] = ~0; /* num is the numerator (=1) */
-		denom[0] = ~0; /* denom is the numerator (=1) */
+		lagrange_weight(num, (const uint32_t (*)[8]) xs, k, idx1);
+		gf256_mul(num, num, ys[idx1]); /* scaled coefficient */
+		gf256_add(secret, num);
+	}
+	unbitslice(key, secret);
+	sss_memzero(ys, sizeof(ys));
+	sss_memzero(num, sizeof(num));
+	sss_memzero(secret, sizeof(secret));
+	sss_STATS_PHASE(keyshare_combine_ticks, start);
+	sss_PROBE1(combine_keyshares__return, k);
+}
+
+
+/*
+ * Evaluate the polynomial through the `k` shares in `shares` at the `m` x
+ * values in `at`, and write the y value for `at[i]` to `out[i * stride]`.
+ */
+static void
+interpolate(uint8_t *out,
+            size_t stride,
+            const uint8_t *at,
+            size_t m,
+            const sss_Keyshare *shares,
+            size_t k)
+{
+	size_t share_idx, idx1, idx2;
+	uint32_t xs[k][8], cs[k][8], suffix[k][8];
+	uint32_t x[8], prefix[8], tmp[8], y[8];
+
+	assert(k != 0);
+
+	/*
+	 * The basis polynomial for share i at x is
+	 *
+	 *     l_i(x) = prod_{j != i} (x - x_j) / prod_{j != i} (x_i - x_j)
+	 *
+	 * The denominators do not depend on x, so we compute them once and fold
+	 * them into the y values: c_i = y_i / prod_{j != i} (x_i - x_j).
+	 */
+	for (share_idx = 0; share_idx < k; share_idx++) {
+		bitslice_setall(xs[share_idx], shares[share_idx][0]);
+	}
+	for (idx1 = 0; idx1 < k; idx1++) {
+		memset(prefix, 0, sizeof(prefix));
+		prefix[0] = ~0;
 		for (idx2 = 0; idx2 < k; idx2++) {
 			if (idx1 == idx2) continue;
-			gf256_mul(num, num, xs[idx2]);
-			memcpy(tmp, xs[idx1], sizeof(uint32_t[8]));
+			memcpy(tmp, xs[idx1], sizeof(tmp));
 			gf256_add(tmp, xs[idx2]);
-			gf256_mul(denom, denom, tmp);
+			gf256_mul(prefix, prefix, tmp);
 		}
-		gf256_inv(tmp, denom); /* inverted denominator */
-		gf256_mul(num, num, tmp); /* basis polynomial */
-		gf256_mul(num, num, ys[idx1]); /* scaled coefficient */
-		gf256_add(secret, num);
+		gf256_inv(tmp, prefix);
+		bitslice(cs[idx1], &shares[idx1][1]);
+		gf256_mul(cs[idx1], cs[idx1], tmp);
+	}
+
+	/*
+	 * For every new x, the numerators are the products of all (x - x_j)
+	 * except one, which we get from prefix and suffix products in O(k).
+	 * If x is one of the existing x values, this gives back that share.
+	 */
+	for (idx1 = 0; idx1 < m; idx1++) {
+		bitslice_setall(x, at[idx1]);
+		memset(suffix[k - 1], 0, sizeof(suffix[k - 1]));
+		suffix[k - 1][0] = ~0;
+		for (idx2 = k - 1; idx2 > 0; idx2--) {
+			memcpy(tmp, x, sizeof(tmp));
+			gf256_add(tmp, xs[idx2]);
+			gf256_mul(suffix[idx2 - 1], suffix[idx2], tmp);
+		}
+		memset(prefix, 0, sizeof(prefix));
+		prefix[0] = ~0;
+		memset(y, 0, sizeof(y));
+		for (idx2 = 0; idx2 < k; idx2++) {
+			gf256_mul(tmp, prefix, suffix[idx2]);
+			gf256_mul(tmp, tmp, cs[idx2]);
+			gf256_add(y, tmp);
+			memcpy(tmp, x, sizeof(tmp));
+			gf256_add(tmp, xs[idx2]);
+			gf256_mul(prefix, prefix, tmp);
+		}
+		unbitslice(&out[idx1 * stride], y);
+	}
+	sss_memzero(cs, sizeof(cs));
+	sss_memzero(tmp, sizeof(tmp));
+	sss_memzero(y, sizeof(y));
+}
+
+
+int
+sss_enroll_keyshares(sss_Keyshare *out,
+                     const uint8_t *new_xs,
+                     size_t m,
+                     const sss_Keyshare *shares,
+                     uint8_t k)
+{
+	size_t idx;
+
+	/* x = 0 would give away the key */
+	for (idx = 0; idx < m; idx++) {
+		if (new_xs[idx] == 0) return -1;
+	}
+
+	interpolate(&out[0][1], sizeof(sss_Keyshare), new_xs, m, shares, k);
+	for (idx = 0; idx < m; idx++) {
+		out[idx][0] = new_xs[idx];
+	}
+	return 0;
+}
+
+
+int
+sss_enroll_keyshare(sss_Keyshare out,
+                    const sss_Keyshare *shares,
+                    uint8_t k,
+                    uint8_t x)
+{
+	return sss_enroll_keyshares((sss_Keyshare*) out, &x, 1, shares, k);
+}
+
+
+/*
+ * The x value at which packed key `idx` is stored. The first key is at x = 0
+ * (like an ordinary key) and the others are at the top of the field, so that
+ * the shares can keep using x = 1..n.
+ */
+static uint8_t
+packed_x(size_t idx)
+{
+	return idx == 0 ? 0 : 256 - idx;
+}
+
+
+void
+sss_create_packed_keyshares(sss_Keyshare *out,
+                            const uint8_t (*keys)[32],
+                            uint8_t l,
+                            uint8_t n,
+                            uint8_t k)
+{
+	assert(l != 0);
+	assert(k != 0);
+	assert(k + l <= n);
+	assert(n + l <= 256);
+
+	size_t idx;
+	uint8_t at[n - k];
+	sss_Keyshare points[k + l];
+
+	/*
+	 * The polynomial goes through the keys and through `k` random points at
+	 * x = 1..k, which are the first `k` shares. The other shares are
+	 * interpolated from these `k + l` points.
+	 */
+	for (idx = 0; idx < l; idx++) {
+		points[idx][0] = packed_x(idx);
+		memcpy(&points[idx][1], keys[idx], 32);
+	}
+	for (idx = 0; idx < k; idx++) {
+		points[l + idx][0] = idx + 1;
+		randombytes(&points[l + idx][1], 32);
+	}
+	for (idx = 0; idx < (size_t) (n - k); idx++) {
+		at[idx] = k + idx + 1;
+		out[k + idx][0] = at[idx];
+	}
+	interpolate(&out[k][1], sizeof(sss_Keyshare), at, n - k,
+	            (const sss_Keyshare*) points, k + l);
+	memcpy(out, &points[l], k * sizeof(sss_Keyshare));
+	sss_memzero(points, sizeof(points));
+}
+
+
+void
+sss_combine_packed_keyshares(uint8_t (*keys)[32],
+                             uint8_t l,
+                             const sss_Keyshare *shares,
+                             uint8_t k)
+{
+	size_t idx;
+	uint8_t at[l];
+
+	assert(l != 0);
+
+	for (idx = 0; idx < l; idx++) {
+		at[idx] = packed_x(idx);
+	}
+	interpolate(&keys[0][0], 32, at, l, shares, (size_t) k + l);
+}
+
+
+/*
+ * Workspace for the `_ctx` variants of the create and combine functions.
+ *
+ * All of the buffers live in one allocation, and every buffer starts on its
+ * own cache line. `xcache` and `weights` remember the Lagrange weights for the
+ * last set of x values that was combined. (The x values are public, so we can
+ * safely branch on them.) `rng` holds randomness that was read ahead from the
+ * OS, of which the first `rng_pos` bytes have been used (and wiped).
+ */
+struct sss_Ctx {
+	uint8_t n_max, k_max;
+	uint8_t cached_k;
+	uint8_t *xcache;
+	uint32_t (*poly)[8], (*xs)[8], (*ys)[8], (*weights)[8];
+	sss_Keyshare *keyshares;
+	sss_Threadpool *threadpool;
+	uint8_t *rng, *secret;
+	size_t rng_pos; /* == sss_CTX_RNG_LEN when the buffer is empty */
+	int rng_buffered;
+	void *mem;
+	size_t mem_len;
+	sss_Arena *arena; /* owns `mem` and the struct itself, if not NULL */
+};
+
+
+#define CACHELINE 64
+#define CACHELINE_ROUND(x) (((x) + CACHELINE - 1) & ~(size_t) (CACHELINE - 1))
+
+
+/*
+ * Length of the scratch space of a workspace, which is laid out as
+ * | poly | xs | ys | weights | xcache | keyshares | rng | secret |
+ */
+static size_t
+ctx_mem_len(uint8_t n_max, uint8_t k_max)
+{
+	size_t ks_count = n_max > k_max ? n_max : k_max;
+	size_t vec_len = CACHELINE_ROUND(k_max * sizeof(uint32_t[8]));
+	size_t xcache_len = CACHELINE_ROUND(k_max);
+	size_t ks_len = CACHELINE_ROUND(ks_count * sizeof(sss_Keyshare));
+	return 4 * vec_len + xcache_len + ks_len + sss_CTX_RNG_LEN +
+	       CACHELINE_ROUND(sss_CTX_SECRET_LEN);
+}
+
+
+/*
+ * Allocate a workspace, either from `arena` or (if `arena` is NULL) from the
+ * heap
+ */
+static sss_Ctx*
+ctx_new(sss_Arena *arena, uint8_t n_max, uint8_t k_max)
+{
+	sss_Ctx *ctx;
+	size_t ks_count = n_max > k_max ? n_max : k_max;
+	size_t vec_len = CACHELINE_ROUND(k_max * sizeof(uint32_t[8]));
+	size_t xcache_len = CACHELINE_ROUND(k_max);
+	size_t ks_len = CACHELINE_ROUND(ks_count * sizeof(sss_Keyshare));
+	size_t mem_len = ctx_mem_len(n_max, k_max);
+	size_t mark;
+	uint8_t *mem;
+
+	assert(n_max != 0);
+	assert(k_max != 0);
+
+	if (arena != NULL) {
+		mark = sss_arena_mark(arena);
+		ctx = sss_arena_alloc(arena, sizeof(*ctx));
+		mem = sss_arena_alloc(arena, mem_len);
+		if (ctx == NULL || mem == NULL) {
+			sss_arena_release(arena, mark);
+			return NULL;
+		}
+		ctx->mem = mem;
+	} else {
+		ctx = calloc(1, sizeof(*ctx));
+		if (ctx == NULL) return NULL;
+		if (posix_memalign(&ctx->mem, CACHELINE, mem_len) != 0) {
+			free(ctx);
+			return NULL;
+		}
+		mem = ctx->mem;
+		memset(mem, 0, mem_len);
+	}
+	ctx->arena = arena;
+	ctx->mem_len = mem_len;
+	ctx->n_max = n_max;
+	ctx->k_max = k_max;
+	ctx->poly = (uint32_t (*)[8]) &mem[0];
+	ctx->xs = (uint32_t (*)[8]) &mem[vec_len];
+	ctx->ys = (uint32_t (*)[8]) &mem[2 * vec_len];
+	ctx->weights = (uint32_t (*)[8]) &mem[3 * vec_len];
+	ctx->xcache = &mem[4 * vec_len];
+	ctx->keyshares = (sss_Keyshare*) &mem[4 * vec_len + xcache_len];
+	ctx->rng = &mem[4 * vec_len + xcache_len + ks_len];
+	ctx->secret = &ctx->rng[sss_CTX_RNG_LEN];
+	ctx->rng_pos = sss_CTX_RNG_LEN;
+	return ctx;
+}
+
+
+sss_Ctx*
+sss_ctx_new(uint8_t n_max, uint8_t k_max)
+{
+	return ctx_new(NULL, n_max, k_max);
+}
+
+
+sss_Ctx*
+sss_ctx_new_in(sss_Arena *arena, uint8_t n_max, uint8_t k_max)
+{
+	return ctx_new(arena, n_max, k_max);
+}
+
+
+size_t
+sss_ctx_arena_size(uint8_t n_max, uint8_t k_max)
+{
+	size_t ctx_len = (sizeof(sss_Ctx) + sss_ARENA_ALIGN - 1) &
+	                 ~(size_t) (sss_ARENA_ALIGN - 1);
+
+	assert(n_max != 0);
+	assert(k_max != 0);
+	return ctx_len + ctx_mem_len(n_max, k_max);
+}
+
+
+void
+sss_ctx_free(sss_Ctx *ctx)
+{
+	if (ctx == NULL) return;
+	sss_memzero(ctx->mem, ctx->mem_len);
+	if (ctx->arena != NULL) {
+		/* The memory is returned when the arena is released */
+		sss_memzero(ctx, sizeof(*ctx));
+		return;
+	}
+	free(ctx->mem);
+	free(ctx);
+}
+
+
+sss_Keyshare*
+sss_ctx_keyshares(sss_Ctx *ctx)
+{
+	return ctx->keyshares;
+}
+
+
+uint8_t*
+sss_ctx_secret(sss_Ctx *ctx)
+{
+	return ctx->secret;
+}
+
+
+void
+sss_ctx_buffer_randomness(sss_Ctx *ctx, int enable)
+{
+	sss_memzero(ctx->rng, sss_CTX_RNG_LEN);
+	ctx->rng_pos = sss_CTX_RNG_LEN;
+	ctx->rng_buffered = enable;
+}
+
+
+void
+sss_ctx_randombytes(sss_Ctx *ctx, void *buf, size_t len)
+{
+	uint8_t *out = buf;
+	size_t chunk;
+
+	if (!ctx->rng_buffered) {
+		randombytes(buf, len);
+		return;
+	}
+	while (len > 0) {
+		if (ctx->rng_pos == sss_CTX_RNG_LEN) {
+			randombytes(ctx->rng, sss_CTX_RNG_LEN);
+			ctx->rng_pos = 0;
+		}
+		chunk = sss_CTX_RNG_LEN - ctx->rng_pos;
+		if (chunk > len) chunk = len;
+		memcpy(out, &ctx->rng[ctx->rng_pos], chunk);
+		sss_memzero(&ctx->rng[ctx->rng_pos], chunk);
+		ctx->rng_pos += chunk;
+		out += chunk;
+		len -= chunk;
+	}
+}
+
+
+void
+sss_ctx_set_threadpool(sss_Ctx *ctx, sss_Threadpool *threadpool)
+{
+	ctx->threadpool = threadpool;
+}
+
+
+/*
+ * Job for evaluating a block of the key shares on a worker thread
+ */
+typedef struct {
+	sss_Keyshare *out;
+	const uint32_t *poly0;
+	const uint32_t (*poly)[8];
+	uint8_t k;
+} CreateJob;
+
+
+static void
+create_task(void *arg, size_t begin, size_t end, size_t worker)
+{
+	const CreateJob *job = arg;
+	(void) worker;
+	eval_keyshares(job->out, job->poly0, job->poly, begin, end, job->k);
+}
+
+
+/*
+ * Job for computing a block of the Lagrange terms on a worker thread. Every
+ * worker writes its partial sum to its own slot in `partial`.
+ */
+typedef struct {
+	sss_Ctx *ctx;
+	uint8_t k;
+	uint32_t partial[sss_THREADPOOL_MAX][8];
+} CombineJob;
+
+
+static void
+combine_task(void *arg, size_t begin, size_t end, size_t worker)
+{
+	CombineJob *job = arg;
+	sss_Ctx *ctx = job->ctx;
+	uint32_t tmp[8];
+	size_t idx1;
+
+	for (idx1 = begin; idx1 < end; idx1++) {
+		lagrange_weight(ctx->weights[idx1],
+		                (const uint32_t (*)[8]) ctx->xs, job->k, idx1);
+		gf256_mul(tmp, ctx->weights[idx1], ctx->ys[idx1]);
+		gf256_add(job->partial[worker], tmp);
+	}
+	sss_memzero(tmp, sizeof(tmp));
+}
+
+
+/*
+ * Check if `ctx` already knows the Lagrange weights for the x values of the
+ * `k` shares in `key_shares`. If it does not, load the x values into `xcache`
+ * and `xs`; the caller then has to compute the weights and set `cached_k`.
+ */
+static int
+ctx_load_xs(sss_Ctx *ctx, const sss_Keyshare *key_shares, uint8_t k)
+{
+	size_t share_idx;
+	int cached;
+
+	cached = ctx->cached_k == k;
+	for (share_idx = 0; cached && share_idx < k; share_idx++) {
+		cached = ctx->xcache[share_idx] == key_shares[share_idx][0];
+	}
+	if (cached) return 1;
+
+	ctx->cached_k = 0;
+	for (share_idx = 0; share_idx < k; share_idx++) {
+		ctx->xcache[share_idx] = key_shares[share_idx][0];
+		bitslice_setall(ctx->xs[share_idx], ctx->xcache[share_idx]);
+	}
+	return 0;
+}
+
+
+void
+sss_create_keyshares_ctx(sss_Ctx *ctx,
+                         sss_Keyshare *out,
+                         const uint8_t key[32],
+                         uint8_t n,
+                         uint8_t k)
+{
+	uint32_t poly0[8];
+	CreateJob job;
+
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+	assert(n <= ctx->n_max);
+	assert(k <= ctx->k_max);
+
+	sss_PROBE2(create_keyshares__entry, n, k);
+	sss_STATS_ADD(create_keyshares_calls, 1);
+	sss_STATS_START(start);
+	bitslice(poly0, key);
+	sss_STATS_START(random_start);
+	sss_ctx_randombytes(ctx, ctx->poly, (k-1) * sizeof(uint32_t[8]));
+	sss_STATS_PHASE(randomness_ticks, random_start);
+	if (ctx->threadpool != NULL && n * k >= sss_MT_THRESHOLD) {
+		job.out = out;
+		job.poly0 = poly0;
+		job.poly = (const uint32_t (*)[8]) ctx->poly;
+		job.k = k;
+		sss_threadpool_run(ctx->threadpool, create_task, &job, n);
+	} else {
+		eval_keyshares(out, poly0, (const uint32_t (*)[8]) ctx->poly,
+		               0, n, k);
+	}
+	sss_memzero(ctx->poly, (k-1) * sizeof(uint32_t[8]));
+	sss_memzero(poly0, sizeof(poly0));
+	sss_STATS_PHASE(keyshare_create_ticks, start);
+	sss_PROBE2(create_keyshares__return, n, k);
+}
+
+
+void
+sss_combine_keyshares_ctx(sss_Ctx *ctx,
+                          uint8_t key[32],
+                          const sss_Keyshare *key_shares,
+                          uint8_t k)
+{
+	size_t share_idx, idx1;
+	uint32_t tmp[8];
+	uint32_t secret[8] = {0};
+	CombineJob job;
+	int cached;
+
+	assert(k <= ctx->k_max);
+
+	sss_PROBE1(combine_keyshares__entry, k);
+	sss_STATS_ADD(combine_keyshares_calls, 1);
+	sss_STATS_START(start);
+	cached = ctx_load_xs(ctx, key_shares, k);
+	for (share_idx = 0; share_idx < k; share_idx++) {
+		bitslice(ctx->ys[share_idx], &key_shares[share_idx][1]);
+	}
+
+	if (!cached && ctx->threadpool != NULL && k * k >= sss_MT_THRESHOLD) {
+		/* Compute the weights and the terms in parallel */
+		memset(job.partial, 0, sizeof(job.partial));
+		job.ctx = ctx;
+		job.k = k;
+		sss_threadpool_run(ctx->threadpool, combine_task, &job, k);
+		for (idx1 = 0; idx1 < sss_threadpool_size(ctx->threadpool); idx1++) {
+			gf256_add(secret, job.partial[idx1]);
+		}
+		sss_memzero(job.partial, sizeof(job.partial));
+		ctx->cached_k = k;
+	} else {
+		if (!cached) {
+			for (idx1 = 0; idx1 < k; idx1++) {
+				lagrange_weight(ctx->weights[idx1],
+				                (const uint32_t (*)[8]) ctx->xs,
+				                k, idx1);
+			}
+			ctx->cached_k = k;
+		}
+		for (idx1 = 0; idx1 < k; idx1++) {
+			gf256_mul(tmp, ctx->weights[idx1], ctx->ys[idx1]);
+			gf256_add(secret, tmp);
+		}
+	}
+	unbitslice(key, secret);
+	sss_memzero(ctx->ys, k * sizeof(uint32_t[8]));
+	sss_memzero(secret, sizeof(secret));
+	sss_memzero(tmp, sizeof(tmp));
+	sss_STATS_PHASE(keyshare_combine_ticks, start);
+	sss_PROBE1(combine_keyshares__return, k);
+}
+
+
+void
+sss_reshare_keyshare(sss_Keyshare *out,
+                     const sss_Keyshare share,
+                     uint8_t n2,
+                     uint8_t k2)
+{
+	sss_create_keyshares(out, &share[1], n2, k2);
+}
+
+
+int
+sss_combine_subshares(sss_Keyshare out,
+                      const sss_Keyshare *subshares,
+                      const uint8_t *old_xs,
+                      uint8_t k)
+{
+	size_t idx;
+	uint32_t xs[k][8], w[8], y[8], sum[8] = {0};
+
+	assert(k != 0);
+
+	for (idx = 0; idx < k; idx++) {
+		if (subshares[idx][0] != subshares[0][0]) return -1;
+		bitslice_setall(xs[idx], old_xs[idx]);
+	}
+	for (idx = 0; idx < k; idx++) {
+		lagrange_weight(w, (const uint32_t (*)[8]) xs, k, idx);
+		bitslice(y, &subshares[idx][1]);
+		gf256_mul(y, y, w);
+		gf256_add(sum, y);
+	}
+	out[0] = subshares[0][0];
+	unbitslice(&out[1], sum);
+	sss_memzero(y, sizeof(y));
+	sss_memzero(sum, sizeof(sum));
+	return 0;
+}
+
+
+/*
+ * Run both halves of the resharing protocol: every old share (with bitsliced
+ * y value `ys[i]` and Lagrange weight `weights[i]`) is shared with a fresh
+ * polynomial of degree `k2-1`, and the sub-shares are combined into `n2` new
+ * shares in `out`. `poly` is scratch space for `k2` coefficients. If `ctx` is
+ * not NULL, the randomness is taken from `ctx`.
+ *
+ * Scaling the polynomial by the weight first gives the weighted sub-shares
+ * directly. Because bitslicing is linear, every weighted sub-share is
+ * unbitsliced and XOR'ed into the new share.
+ */
+static void
+reshare_keyshares(sss_Ctx *ctx,
+                  sss_Keyshare *out,
+                  const uint32_t weights[][8],
+                  const uint32_t ys[][8],
+                  uint32_t poly[][8],
+                  uint8_t k,
+                  uint8_t n2,
+                  uint8_t k2)
+{
+	size_t old_idx, share_idx, idx;
+	uint8_t coeff_idx, delta[32];
+	uint32_t x[8], y[8];
+
+	memset(out, 0, n2 * sizeof(sss_Keyshare));
+	for (old_idx = 0; old_idx < k; old_idx++) {
+		memcpy(poly[0], ys[old_idx], sizeof(uint32_t[8]));
+		if (ctx != NULL) {
+			sss_ctx_randombytes(ctx, poly[1], (k2-1) * sizeof(uint32_t[8]));
+		} else {
+			randombytes((void*) poly[1], (k2-1) * sizeof(uint32_t[8]));
+		}
+		for (coeff_idx = 0; coeff_idx < k2; coeff_idx++) {
+			gf256_mul(poly[coeff_idx], poly[coeff_idx], weights[old_idx]);
+		}
+
+		for (share_idx = 0; share_idx < n2; share_idx++) {
+			bitslice_setall(x, share_idx + 1);
+			memcpy(y, poly[k2 - 1], sizeof(y));
+			for (coeff_idx = k2 - 1; coeff_idx > 0; coeff_idx--) {
+				gf256_mul(y, y, x);
+				gf256_add(y, poly[coeff_idx - 1]);
+			}
+			unbitslice(delta, y);
+			for (idx = 0; idx < 32; idx++) {
+				out[share_idx][1 + idx] ^= delta[idx];
+			}
+		}
+	}
+	for (share_idx = 0; share_idx < n2; share_idx++) {
+		out[share_idx][0] = share_idx + 1;
+	}
+	sss_memzero(poly, k2 * sizeof(uint32_t[8]));
+	sss_memzero(y, sizeof(y));
+	sss_memzero(delta, sizeof(delta));
+}
+
+
+void
+sss_reshare_keyshares(sss_Keyshare *out,
+                      const sss_Keyshare *shares,
+                      uint8_t k,
+                      uint8_t n2,
+                      uint8_t k2)
+{
+	assert(k != 0);
+	assert(n2 != 0);
+	assert(k2 != 0);
+	assert(k2 <= n2);
+
+	size_t idx;
+	uint32_t xs[k][8], ys[k][8], weights[k][8], poly[k2][8];
+
+	for (idx = 0; idx < k; idx++) {
+		bitslice_setall(xs[idx], shares[idx][0]);
+		bitslice(ys[idx], &shares[idx][1]);
+	}
+	for (idx = 0; idx < k; idx++) {
+		lagrange_weight(weights[idx], (const uint32_t (*)[8]) xs, k, idx);
+	}
+	reshare_keyshares(NULL, out, (const uint32_t (*)[8]) weights,
+	                  (const uint32_t (*)[8]) ys, poly, k, n2, k2);
+	sss_memzero(ys, sizeof(ys));
+}
+
+
+void
+sss_reshare_keyshares_ctx(sss_Ctx *ctx,
+                          sss_Keyshare *out,
+                          const sss_Keyshare *shares,
+                          uint8_t k,
+                          uint8_t n2,
+                          uint8_t k2)
+{
+	size_t idx;
+
+	assert(k != 0);
+	assert(n2 != 0);
+	assert(k2 != 0);
+	assert(k2 <= n2);
+	assert(k <= ctx->k_max);
+	assert(k2 <= ctx->k_max);
+
+	/* Read all of the old shares first, because `out` may overlap them */
+	if (!ctx_load_xs(ctx, shares, k)) {
+		for (idx = 0; idx < k; idx++) {
+			lagrange_weight(ctx->weights[idx],
+			                (const uint32_t (*)[8]) ctx->xs, k, idx);
+		}
+		ctx->cached_k = k;
+	}
+	for (idx = 0; idx < k; idx++) {
+		bitslice(ctx->ys[idx], &shares[idx][1]);
+	}
+	reshare_keyshares(ctx, out, (const uint32_t (*)[8]) ctx->weights,
+	                  (const uint32_t (*)[8]) ctx->ys, ctx->poly, k, n2, k2);
+	sss_memzero(ctx->ys, k * sizeof(uint32_t[8]));
+}
+
+
+/*
+ * Add the shares of the polynomial with a zero constant term and the `k-1`
+ * other terms in `poly` to the `n` key shares in `shares`.
+ *
+ * The y values of the shares are not needed to evaluate the polynomial, and
+ * bitslicing is linear, so the bitsliced update is unbitsliced and XOR'ed
+ * into the share (like `sss_apply_keyshares`).
+ */
+static void
+refresh_keyshares(sss_Keyshare *shares,
+                  const uint32_t poly[][8],
+                  uint8_t n,
+                  uint8_t k)
+{
+	size_t share_idx, idx;
+	uint8_t coeff_idx, delta[32];
+	uint32_t x[8], y[8];
+
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		bitslice_setall(x, shares[share_idx][0]);
+
+		/* Horner's method, with a zero constant term */
+		memset(y, 0, sizeof(y));
+		for (coeff_idx = k - 1; coeff_idx > 0; coeff_idx--) {
+			gf256_add(y, poly[coeff_idx - 1]);
+			gf256_mul(y, y, x);
+		}
+		unbitslice(delta, y);
+		for (idx = 0; idx < 32; idx++) {
+			shares[share_idx][1 + idx] ^= delta[idx];
+		}
+	}
+	sss_memzero(y, sizeof(y));
+	sss_memzero(delta, sizeof(delta));
+}
+
+
+void
+sss_refresh_keyshares(sss_Keyshare *shares, uint8_t n, uint8_t k)
+{
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	uint32_t poly[k-1][8];
+
+	randombytes((void*) poly, sizeof(poly));
+	refresh_keyshares(shares, (const uint32_t (*)[8]) poly, n, k);
+	sss_memzero(poly, sizeof(poly));
+}
+
+
+void
+sss_refresh_keyshares_ctx(sss_Ctx *ctx,
+                          sss_Keyshare *shares,
+                          uint8_t n,
+                          uint8_t k)
+{
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+	assert(k <= ctx->k_max);
+
+	sss_ctx_randombytes(ctx, ctx->poly, (k-1) * sizeof(uint32_t[8]));
+	refresh_keyshares(shares, (const uint32_t (*)[8]) ctx->poly, n, k);
+	sss_memzero(ctx->poly, (k-1) * sizeof(uint32_t[8]));
+}
+
+
+/*
+ * State of an incremental combine.
+ *
+ * The secret is reconstructed with Newton's divided differences. After `m`
+ * shares have been added, `t[j]` holds the divided difference
+ * f[x_j, ..., x_{m-1}], `value` holds the Newton interpolant of the first `m`
+ * shares evaluated at x = 0 and `prod` holds x_0 * ... * x_{m-1}.
+ *
+ * Adding share `m` updates the last diagonal of the divided difference table
+ * (`t`), which needs a division by (x_m - x_j) for all j < m. All of these
+ * denominators are inverted at once with Montgomery's trick, so adding a
+ * share costs one inversion and O(m) multiplications. The new Newton
+ * coefficient is then t[0], which we immediately fold into `value`.
+ */
+struct sss_KeyshareCombiner {
+	uint8_t k, m;
+	uint8_t x[255];
+	uint32_t value[8], prod[8];
+	uint32_t (*t)[8], (*denom)[8], (*acc)[8];
+};
+
+
+sss_KeyshareCombiner*
+sss_keyshare_combiner_new(uint8_t k)
+{
+	sss_KeyshareCombiner *combiner;
+	uint8_t *mem;
+
+	assert(k != 0);
+
+	mem = calloc(1, sizeof(*combiner) + 3 * k * sizeof(uint32_t[8]));
+	if (mem == NULL) return NULL;
+	combiner = (sss_KeyshareCombiner*) mem;
+	mem += sizeof(*combiner);
+	combiner->k = k;
+	combiner->t = (uint32_t (*)[8]) &mem[0];
+	combiner->denom = (uint32_t (*)[8]) &mem[k * sizeof(uint32_t[8])];
+	combiner->acc = (uint32_t (*)[8]) &mem[2 * k * sizeof(uint32_t[8])];
+	return combiner;
+}
+
+
+int
+sss_keyshare_combiner_add(sss_KeyshareCombiner *combiner,
+                          const sss_Keyshare share)
+{
+	uint32_t (*t)[8] = combiner->t;
+	uint32_t (*denom)[8] = combiner->denom;
+	uint32_t (*acc)[8] = combiner->acc;
+	uint32_t xm[8], inv[8], tmp[8];
+	size_t idx, m = combiner->m;
+
+	/* The x values are public, so we can check them in variable time */
+	if (m == combiner->k || share[0] == 0) return -1;
+	for (idx = 0; idx < m; idx++) {
+		if (combiner->x[idx] == share[0]) return -1;
+	}
+	combiner->x[m] = share[0];
+	bitslice_setall(xm, share[0]);
+	bitslice(t[m], &share[1]);
+
+	if (m > 0) {
+		/* Invert all of the denominators (x_m - x_j) at once */
+		for (idx = 0; idx < m; idx++) {
+			bitslice_setall(denom[idx], combiner->x[idx]);
+			gf256_add(denom[idx], xm);
+			if (idx == 0) {
+				memcpy(acc[0], denom[0], sizeof(uint32_t[8]));
+			} else {
+				gf256_mul(acc[idx], acc[idx-1], denom[idx]);
+			}
+		}
+		gf256_inv(inv, acc[m-1]);
+		for (idx = m - 1; idx > 0; idx--) {
+			gf256_mul(tmp, inv, acc[idx-1]);
+			gf256_mul(inv, inv, denom[idx]);
+			memcpy(denom[idx], tmp, sizeof(uint32_t[8]));
+		}
+		memcpy(denom[0], inv, sizeof(uint32_t[8]));
+
+		/* Update the last diagonal of the divided difference table */
+		for (idx = m; idx > 0; idx--) {
+			gf256_add(t[idx-1], t[idx]);
+			gf256_mul(t[idx-1], t[idx-1], denom[idx-1]);
+		}
+	} else {
+		memset(combiner->prod, 0, sizeof(combiner->prod));
+		combiner->prod[0] = ~0;
+	}
+
+	/* Add the new Newton term to the value at x = 0 */
+	gf256_mul(tmp, t[0], combiner->prod);
+	gf256_add(combiner->value, tmp);
+	gf256_mul(combiner->prod, combiner->prod, xm);
+	combiner->m++;
+
+	sss_memzero(tmp, sizeof(tmp));
+	return 0;
+}
+
+
+uint8_t
+sss_keyshare_combiner_count(const sss_KeyshareCombiner *combiner)
+{
+	return combiner->m;
+}
+
+
+void
+sss_keyshare_combiner_finalize(const sss_KeyshareCombiner *combiner,
+                               uint8_t key[32])
+{
+	unbitslice(key, combiner->value);
+}
+
+
+/*
+ * Divided differences are symmetric in their arguments, so `t[j]` is also the
+ * j-th Newton coefficient for the nodes in reverse order (x_{m-1}, ..., x_0).
+ * This means that we can evaluate the interpolant with Horner's method
+ * without any inversions.
+ */
+void
+sss_keyshare_combiner_eval(const sss_KeyshareCombiner *combiner,
+                           sss_Keyshare out,
+                           uint8_t x)
+{
+	uint32_t xs[8], val[8], tmp[8];
+	size_t idx, m = combiner->m;
+
+	memset(val, 0, sizeof(val));
+	if (m > 0) memcpy(val, combiner->t[0], sizeof(val));
+	bitslice_setall(xs, x);
+	for (idx = 1; idx < m; idx++) {
+		bitslice_setall(tmp, combiner->x[idx]);
+		gf256_add(tmp, xs);
+		gf256_mul(val, val, tmp);
+		gf256_add(val, combiner->t[idx]);
+	}
+	out[0] = x;
+	unbitslice(&out[1], val);
+	sss_memzero(val, sizeof(val));
+}
+
+
+void
+sss_keyshare_combiner_free(sss_KeyshareCombiner *combiner)
+{
+	if (combiner == NULL) return;
+	sss_memzero(combiner, sizeof(*combiner)
+	                      + 3 * combiner->k * sizeof(uint32_t[8]));
+	free(combiner);
+}
+
+
+/*
+ * Return a mask that has bit `i` set if lane `i` of `x` is nonzero
+ */
+static uint32_t
+gf256_nonzero(const uint32_t x[8])
+{
+	return x[0] | x[1] | x[2] | x[3] | x[4] | x[5] | x[6] | x[7];
+}
+
+
+/*
+ * Set `r` to `a` in the lanes where `mask` is set, and leave the other lanes
+ * alone.
+ */
+static void
+gf256_select(uint32_t r[8], const uint32_t a[8], uint32_t mask)
+{
+	size_t idx;
+	for (idx = 0; idx < 8; idx++) r[idx] = (a[idx] & mask) | (r[idx] & ~mask);
+}
+
+
+/*
+ * Compute the public constant `c` minus the bitsliced integer `a` of `bits`
+ * bits, and write the result to `r` (if not NULL). Returns a mask that has bit
+ * `i` set if lane `i` of `a` is at most `c`.
+ */
+static uint32_t
+bitsliced_sub(uint32_t *r, size_t c, const uint32_t *a, size_t bits)
+{
+	size_t idx;
+	uint32_t x, borrow = 0;
+
+	for (idx = 0; idx < bits; idx++) {
+		x = -(uint32_t) ((c >> idx) & 1);
+		if (r != NULL) r[idx] = x ^ a[idx] ^ borrow;
+		borrow = (~x & a[idx]) | (~(x ^ a[idx]) & borrow);
+	}
+	return ~borrow;
+}
+
+
+/*
+ * Compute the syndromes S_0, ..., S_{r-1} of the `m` points in `xs` and `ys`
+ * and write them to `syn`.
+ *
+ * The points are seen as a codeword of the (generalized) Reed-Solomon code
+ * of evaluations of polynomials with degree < m - r. With the column
+ * multipliers v_i = 1 / prod_{j != i} (x_i - x_j), the syndromes are
+ * S_l = sum_i v_i y_i x_i^l, which are all zero if and only if the points lie
+ * on such a polynomial.
+ */
+static void
+syndromes(uint32_t syn[][8],
+          const uint32_t xs[][8],
+          const uint32_t ys[][8],
+          size_t m,
+          size_t r)
+{
+	size_t idx1, idx2;
+	uint32_t v[8], tmp[8];
+
+	memset(syn, 0, r * sizeof(uint32_t[8]));
+	for (idx1 = 0; idx1 < m; idx1++) {
+		memset(v, 0, sizeof(v));
+		v[0] = ~0;
+		for (idx2 = 0; idx2 < m; idx2++) {
+			if (idx1 == idx2) continue;
+			memcpy(tmp, xs[idx1], sizeof(tmp));
+			gf256_add(tmp, xs[idx2]);
+			gf256_mul(v, v, tmp);
+		}
+		gf256_inv(tmp, v);
+		gf256_mul(v, tmp, ys[idx1]);
+		for (idx2 = 0; idx2 < r; idx2++) {
+			gf256_add(syn[idx2], v);
+			gf256_mul(v, v, xs[idx1]);
+		}
+	}
+	sss_memzero(v, sizeof(v));
+}
+
+
+/*
+ * Find the error locator polynomial for the syndromes in `syn` with the
+ * Berlekamp-Massey algorithm, and write it to `C` (which has room for `r + 2`
+ * coefficients).
+ *
+ * Every lane runs its own instance of the algorithm, so all of the branches
+ * of the textbook algorithm are replaced by per-lane masks. The register
+ * length `L` of every lane is kept as a bitsliced integer. `B` is kept
+ * multiplied by x^m, so it is just shifted every iteration.
+ */
+static void
+berlekamp_massey(uint32_t C[][8], const uint32_t syn[][8], size_t r)
+{
+	uint32_t B[r + 2][8], T[r + 2][8];
+	uint32_t L[9] = { 0 }, twoL[9], newL[9];
+	uint32_t b[8] = { ~0 }, d[8], coef[8], tmp[8];
+	uint32_t update;
+	size_t n, idx;
+
+	memset(C, 0, (r + 2) * sizeof(uint32_t[8]));
+	memset(B, 0, sizeof(B));
+	C[0][0] = ~0; /* C = 1 */
+	B[1][0] = ~0; /* B = x */
+
+	for (n = 0; n < r; n++) {
+		/* Discrepancy */
+		memcpy(d, syn[n], sizeof(d));
+		for (idx = 1; idx <= n; idx++) {
+			gf256_mul(tmp, C[idx], syn[n - idx]);
+			gf256_add(d, tmp);
+		}
+
+		/* Lanes where d != 0 and 2L <= n change their register length */
+		twoL[0] = 0;
+		memcpy(&twoL[1], L, sizeof(uint32_t[8]));
+		update = gf256_nonzero(d) & bitsliced_sub(NULL, n, twoL, 9);
+
+		/* C = C - (d / b) B */
+		memcpy(T, C, sizeof(T));
+		gf256_inv(tmp, b);
+		gf256_mul(coef, d, tmp);
+		for (idx = 1; idx < r + 2; idx++) {
+			gf256_mul(tmp, coef, B[idx]);
+			gf256_add(C[idx], tmp);
+		}
+
+		/* L = n + 1 - L, b = d, B = x T in the lanes that update */
+		bitsliced_sub(newL, n + 1, L, 9);
+		for (idx = 0; idx < 9; idx++) {
+			L[idx] = (newL[idx] & update) | (L[idx] & ~update);
+		}
+		gf256_select(b, d, update);
+		for (idx = r + 1; idx > 0; idx--) {
+			memcpy(B[idx], B[idx - 1], sizeof(uint32_t[8]));
+			gf256_select(B[idx], T[idx - 1], update);
+		}
+		memset(B[0], 0, sizeof(uint32_t[8]));
+	}
+	sss_memzero(B, sizeof(B));
+	sss_memzero(T, sizeof(T));
+	sss_memzero(d, sizeof(d));
+	sss_memzero(coef, sizeof(coef));
+	sss_memzero(tmp, sizeof(tmp));
+}
+
+
+int
+sss_combine_keyshares_robust(uint8_t key[32],
+                             uint8_t *faulty,
+                             const sss_Keyshare *key_shares,
+                             uint8_t n,
+                             uint8_t k)
+{
+	size_t r = n - k, idx1, idx2, good = 0, bad = 0;
+	uint32_t xs[n][8], ys[n][8], syn[r + 1][8], C[r + 2][8];
+	uint32_t z[8], val[8], tmp[8], secret[8] = { 0 };
+	uint32_t zero;
+	int ret = 0;
+
+	assert(k != 0);
+	assert(k <= n);
+
+	/* The x values are public, so we can check them in variable time */
+	for (idx1 = 0; idx1 < n; idx1++) {
+		if (key_shares[idx1][0] == 0) return -1;
+		for (idx2 = 0; idx2 < idx1; idx2++) {
+			if (key_shares[idx1][0] == key_shares[idx2][0]) return -1;
+		}
+	}
+
+	for (idx1 = 0; idx1 < n; idx1++) {
+		bitslice_setall(xs[idx1], key_shares[idx1][0]);
+		bitslice(ys[idx1], &key_shares[idx1][1]);
+	}
+
+	if (r > 0) {
+		/* Find the error locator of every lane */
+		syndromes(syn, (const uint32_t (*)[8]) xs,
+		          (const uint32_t (*)[8]) ys, n, r);
+		berlekamp_massey(C, (const uint32_t (*)[8]) syn, r);
+
+		/*
+		 * Share i is faulty if 1/x_i is a root of the error locator of
+		 * any lane. Only this (public) conclusion is branched on.
+		 */
+		for (idx1 = 0; idx1 < n; idx1++) {
+			gf256_inv(z, xs[idx1]);
+			memcpy(val, C[r], sizeof(val));
+			for (idx2 = r; idx2 > 0; idx2--) {
+				gf256_mul(val, val, z);
+				gf256_add(val, C[idx2 - 1]);
+			}
+			zero = ~gf256_nonzero(val);
+			if (zero != 0) {
+				faulty[bad++] = idx1;
+			} else {
+				/* Move the good shares to the front */
+				memcpy(xs[good], xs[idx1], sizeof(uint32_t[8]));
+				memcpy(ys[good], ys[idx1], sizeof(uint32_t[8]));
+				good++;
+			}
+		}
+	} else {
+		good = n;
+	}
+
+	/* Check that we did not go beyond the error correcting capacity */
+	if (2 * bad > r || good < k) ret = -1;
+
+	/* Check that all of the good shares lie on the same polynomial */
+	if (ret == 0 && good > k) {
+		syndromes(syn, (const uint32_t (*)[8]) xs,
+		          (const uint32_t (*)[8]) ys, good, good - k);
+		zero = 0;
+		for (idx1 = 0; idx1 < good - k; idx1++) {
+			zero |= gf256_nonzero(syn[idx1]);
+		}
+		if (zero != 0) ret = -1;
+	}
+
+	if (ret == 0) {
+		for (idx1 = 0; idx1 < k; idx1++) {
+			lagrange_weight(tmp, (const uint32_t (*)[8]) xs, k, idx1);
+			gf256_mul(tmp, tmp, ys[idx1]);
+			gf256_add(secret, tmp);
+		}
+		unbitslice(key, secret);
+		ret = bad;
+	}
+
+	sss_memzero(ys, sizeof(ys));
+	sss_memzero(syn, sizeof(syn));
+	sss_memzero(C, sizeof(C));
+	sss_memzero(val, sizeof(val));
+	sss_memzero(tmp, sizeof(tmp));
+	sss_memzero(secret, sizeof(secret));
+	return ret;
+}
+
+
+/*
+ * Nonce for expanding the seed of a generator into polynomial coefficients
+ */
+static const unsigned char generator_nonce[crypto_stream_salsa20_NONCEBYTES] = {
+	's', 's', 's', '-', 'p', 'o', 'l', 'y'
+};
+
+
+/*
+ * A polynomial that is kept around to create shares on demand.
+ *
+ * The coefficients (except the constant term, which is the key) are the
+ * salsa20 keystream under the first 32 bytes of sha512(seed || key), so two
+ * different keys never share a polynomial, even under the same seed. Every
+ * coefficient is bitsliced from 32 bytes of keystream, so the polynomial does
+ * not depend on the endianness of the platform.
+ */
+struct sss_KeyshareGenerator {
+	uint8_t k;
+	sss_Arena *arena;
+	uint8_t seed[32];
+	uint32_t (*poly)[8];
+};
+
+
+sss_KeyshareGenerator*
+sss_keyshare_generator_new(sss_Arena *arena,
+                           const uint8_t key[32],
+                           const uint8_t seed[32],
+                           uint8_t k)
+{
+	sss_KeyshareGenerator *gen;
+	size_t len = sizeof(*gen) + k * sizeof(uint32_t[8]);
+	uint8_t input[64], hash[crypto_hash_BYTES];
+	uint32_t tmp[8];
+	uint8_t *mem;
+	size_t idx;
+
+	assert(k != 0);
+
+	mem = arena != NULL ? sss_arena_alloc(arena, len) : calloc(1, len);
+	if (mem == NULL) return NULL;
+	gen = (sss_KeyshareGenerator*) mem;
+	gen->k = k;
+	gen->arena = arena;
+	gen->poly = (uint32_t (*)[8]) &mem[sizeof(*gen)];
+
+	if (seed != NULL) {
+		memcpy(gen->seed, seed, sizeof(gen->seed));
+	} else {
+		randombytes(gen->seed, sizeof(gen->seed));
+	}
+
+	/* Bind the seed to the key, so that a reused seed does not leak */
+	memcpy(&input[0], gen->seed, 32);
+	memcpy(&input[32], key, 32);
+	crypto_hash(hash, input, sizeof(input));
+
+	/* Expand the hash in place, then bitslice every coefficient */
+	bitslice(gen->poly[0], key);
+	crypto_stream_salsa20((uint8_t*) gen->poly[1],
+	                      (k-1) * sizeof(uint32_t[8]),
+	                      generator_nonce, hash);
+	for (idx = 1; idx < k; idx++) {
+		bitslice(tmp, (const uint8_t*) gen->poly[idx]);
+		memcpy(gen->poly[idx], tmp, sizeof(tmp));
+	}
+	sss_memzero(input, sizeof(input));
+	sss_memzero(hash, sizeof(hash));
+	sss_memzero(tmp, sizeof(tmp));
+	return gen;
+}
+
+
+void
+sss_keyshare_generator_seed(const sss_KeyshareGenerator *gen,
+                            uint8_t seed[32])
+{
+	memcpy(seed, gen->seed, sizeof(gen->seed));
+}
+
+
+int
+sss_keyshare_generator_get(const sss_KeyshareGenerator *gen,
+                           sss_Keyshare out,
+                           uint8_t x)
+{
+	uint32_t xs[8], y[8];
+	size_t idx;
+
+	/* x = 0 would give away the key */
+	if (x == 0) return -1;
+
+	/* Horner's method */
+	bitslice_setall(xs, x);
+	memcpy(y, gen->poly[gen->k - 1], sizeof(y));
+	for (idx = gen->k - 1; idx > 0; idx--) {
+		gf256_mul(y, y, xs);
+		gf256_add(y, gen->poly[idx - 1]);
+	}
+	out[0] = x;
+	unbitslice(&out[1], y);
+	sss_memzero(y, sizeof(y));
+	return 0;
+}
+
+
+void
+sss_keyshare_generator_free(sss_KeyshareGenerator *gen)
+{
+	size_t len;
+
+	if (gen == NULL) return;
+	len = sizeof(*gen) + gen->k * sizeof(uint32_t[8]);
+	if (gen->arena != NULL) {
+		/* The memory is returned when the arena is released */
+		sss_memzero(gen, len);
+		return;
+	}
+	sss_memzero(gen, len);
+	free(gen);
+}
+
+
+void
+sss_bitslice_keyshares(sss_BitslicedKeyshare *out,
+                       const sss_Keyshare *in,
+                       size_t n)
+{
+	size_t idx;
+
+	for (idx = 0; idx < n; idx++) {
+		out[idx].x = in[idx][0];
+		bitslice(out[idx].y, &in[idx][1]);
+	}
+}
+
+
+void
+sss_unbitslice_keyshares(sss_Keyshare *out,
+                         const sss_BitslicedKeyshare *in,
+                         size_t n)
+{
+	size_t idx;
+
+	for (idx = 0; idx < n; idx++) {
+		out[idx][0] = in[idx].x;
+		unbitslice(&out[idx][1], in[idx].y);
+	}
+}
+
+
+/*
+ * Add the polynomial with constant term `poly0` and the `k-1` other terms in
+ * `poly` (all evaluated with Horner's method) to the y values of the `n`
+ * shares in `shares`.
+ */
+static void
+eval_bitsliced(sss_BitslicedKeyshare *shares,
+               const uint32_t poly0[8],
+               const uint32_t poly[][8],
+               uint8_t n,
+               uint8_t k)
+{
+	size_t share_idx;
+	uint8_t coeff_idx;
+	uint32_t x[8], y[8];
+
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		bitslice_setall(x, shares[share_idx].x);
+		memset(y, 0, sizeof(y));
+		for (coeff_idx = k - 1; coeff_idx > 0; coeff_idx--) {
+			gf256_add(y, poly[coeff_idx - 1]);
+			gf256_mul(y, y, x);
+		}
+		gf256_add(y, poly0);
+		gf256_add(shares[share_idx].y, y);
+	}
+	sss_memzero(y, sizeof(y));
+}
+
+
+void
+sss_create_keyshares_bitsliced(sss_BitslicedKeyshare *out,
+                               const uint8_t key[32],
+                               uint8_t n,
+                               uint8_t k)
+{
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	size_t share_idx;
+	uint32_t poly0[8], poly[k-1][8];
+
+	bitslice(poly0, key);
+	randombytes((void*) poly, sizeof(poly));
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		out[share_idx].x = share_idx + 1;
+		memset(out[share_idx].y, 0, sizeof(out[share_idx].y));
+	}
+	eval_bitsliced(out, poly0, (const uint32_t (*)[8]) poly, n, k);
+	sss_memzero(poly0, sizeof(poly0));
+	sss_memzero(poly, sizeof(poly));
+}
+
+
+void
+sss_refresh_keyshares_bitsliced(sss_BitslicedKeyshare *shares,
+                                uint8_t n,
+                                uint8_t k)
+{
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	uint32_t poly0[8] = { 0 }, poly[k-1][8];
+
+	randombytes((void*) poly, sizeof(poly));
+	eval_bitsliced(shares, poly0, (const uint32_t (*)[8]) poly, n, k);
+	sss_memzero(poly, sizeof(poly));
+}
+
+
+void
+sss_combine_keyshares_bitsliced(uint8_t key[32],
+                                const sss_BitslicedKeyshare *shares,
+                                uint8_t k)
+{
+	size_t idx;
+	uint32_t xs[k][8], w[8], y[8], secret[8] = { 0 };
+
+	for (idx = 0; idx < k; idx++) {
+		bitslice_setall(xs[idx], shares[idx].x);
+	}
+	for (idx = 0; idx < k; idx++) {
+		lagrange_weight(w, (const uint32_t (*)[8]) xs, k, idx);
+		gf256_mul(y, w, shares[idx].y);
+		gf256_add(secret, y);
 	}
 	unbitslice(key, secret);
+	sss_memzero(y, sizeof(y));
+	sss_memzero(secret, sizeof(secret));
 }
@@ -12,12 +12,40 @@
 #ifndef sss_HAZMAT_H_
 #define sss_HAZMAT_H_
 
+#include "arena.h"
+#include "threadpool.h"
 #include <inttypes.h>
 
 
 #define sss_KEYSHARE_LEN 33 /* 1 + 32 */
 
 
+#ifndef sss_MT_THRESHOLD
+/*
+ * Minimum amount of work (`n * k` when creating and `k * k` when combining)
+ * for which the `_ctx` functions will use a thread pool, if one is set
+ */
+#define sss_MT_THRESHOLD 4096
+#endif
+
+
+/*
+ * Size of the randomness buffer in a workspace (see
+ * `sss_ctx_buffer_randomness`)
+ */
+#define sss_CTX_RNG_LEN 4096
+
+
+#ifndef sss_CTX_SECRET_LEN
+/*
+ * Size of the buffer in a workspace for the ephemeral key and the plaintext
+ * of the higher level functions (see `sss_ctx_secret`). `sss.c` checks at
+ * compile time that this fits `sss_MLEN`.
+ */
+#define sss_CTX_SECRET_LEN 512
+#endif
+
+
 /*
  * One share of a cryptographic key which is shared using Shamir's
  * the `sss_create_keyshares` function.
@@ -45,6 +73,77 @@ void sss_create_keyshares(sss_Keyshare *out,
                           uint8_t k);
 
 
+/*
+ * Precompute `n` shares with a treshold value given in `k` of a random
+ * polynomial whose constant term is zero, and write them to `out`.
+ *
+ * This does all of the work of `sss_create_keyshares` that does not depend
+ * on the key. The resulting shares must be considered secret, must be used
+ * at most once and must be turned into shares of a real key using
+ * `sss_apply_keyshares`.
+ */
+void sss_precompute_keyshares(sss_Keyshare *out,
+                              uint8_t n,
+                              uint8_t k);
+
+
+/*
+ * Add the key given in `key` to the `n` shares in `shares` that were made by
+ * `sss_precompute_keyshares`. Afterwards, `shares` holds `n` shares of `key`,
+ * exactly as if they had been created with `sss_create_keyshares`.
+ *
+ * This function is cheap (it only XORs `key` into every share), and the
+ * same requirements for `key` apply as for `sss_create_keyshares`.
+ */
+void sss_apply_keyshares(sss_Keyshare *shares,
+                         const uint8_t key[32],
+                         uint8_t n);
+
+
+/*
+ * Add the `n` shares in `a` to the `n` shares in `b`, and write the result to
+ * `out` (which may be `a` or `b`). The shares in `a[i]` and `b[i]` must have
+ * the same x value. If `a` and `b` are shares of the keys `key_a` and `key_b`
+ * with the same threshold, then `out` holds shares of `key_a + key_b` (the
+ * bytewise XOR of the keys).
+ *
+ * Returns 0 on success, and -1 if any of the x values do not match (in which
+ * case nothing is written to `out`).
+ */
+int sss_add_keyshares(sss_Keyshare *out,
+                      const sss_Keyshare *a,
+                      const sss_Keyshare *b,
+                      size_t n);
+
+
+/*
+ * Multiply the `n` shares in `shares` by the public constant `c` and write the
+ * result to `out` (which may be `shares`). Afterwards, `out` holds shares of
+ * `c * key`, where every byte of the key is multiplied by `c` in GF(2^8).
+ */
+void sss_scale_keyshares(sss_Keyshare *out,
+                         const sss_Keyshare *shares,
+                         uint8_t c,
+                         size_t n);
+
+
+/*
+ * Compute the linear combination `coeffs[0] * sharings[0] + ... +
+ * coeffs[m-1] * sharings[m-1]` of the `m` sharings of `n` shares each, and
+ * write it to `out` (which may be any of the sharings). The coefficients are
+ * treated as public values. The share at index `i` must have the same x value
+ * in every sharing.
+ *
+ * Returns 0 on success, and -1 if `m` is 0 or if any of the x values do not
+ * match (in which case nothing is written to `out`).
+ */
+int sss_linear_combine_keyshares(sss_Keyshare *out,
+                                 const sss_Keyshare *const *sharings,
+                                 const uint8_t *coeffs,
+                                 size_t m,
+                                 size_t n);
+
+
 /*
  * Combine the `k` shares provided in `shares` and write the resulting key to
  * `key`. The amount of shares used to restore a secret may be larger than the
@@ -67,4 +166,458 @@ void sss_combine_keyshares(uint8_t key[32],
                            uint8_t k);
 
 
+/*
+ * Use the `k` sss_Keyshare structs given in `shares` to compute the share of
+ * the same key for a new participant with x value `x`, and write it to `out`.
+ * This enrolls a new participant without restoring the key and without
+ * dealing new shares to the existing participants.
+ *
+ * The same caveats apply as for `sss_combine_keyshares`. The result should be
+ * treated as a secret value.
+ *
+ * Returns 0 on success, and -1 if `x` is 0.
+ */
+int sss_enroll_keyshare(sss_Keyshare out,
+                        const sss_Keyshare *shares,
+                        uint8_t k,
+                        uint8_t x);
+
+
+/*
+ * Same as `sss_enroll_keyshare`, but for the `m` x values in `xs`. The share
+ * for `xs[i]` is written to `out[i]`. The Lagrange denominators are only
+ * computed once, after which every new share costs O(k).
+ *
+ * Returns 0 on success, and -1 if any of the x values is 0 (in which case
+ * nothing is written to `out`).
+ */
+int sss_enroll_keyshares(sss_Keyshare *out,
+                         const uint8_t *xs,
+                         size_t m,
+                         const sss_Keyshare *shares,
+                         uint8_t k);
+
+
+/*
+ * Create `n` packed key shares of the `l` keys given in `keys` and write them
+ * to `out`. All of the keys are stored in a single polynomial of degree
+ * `k + l - 1`, so every share is still only 33 bytes, instead of `l` times
+ * 33 bytes. Any `k` shares reveal nothing about the keys, and any `k + l`
+ * shares restore all of them.
+ *
+ * This function requires that `k + l <= n` and `n + l <= 256`.
+ */
+void sss_create_packed_keyshares(sss_Keyshare *out,
+                                 const uint8_t (*keys)[32],
+                                 uint8_t l,
+                                 uint8_t n,
+                                 uint8_t k);
+
+
+/*
+ * Restore the `l` keys from the `k + l` packed key shares in `shares` and
+ * write them to `keys`. The same caveats apply as for
+ * `sss_combine_keyshares`.
+ */
+void sss_combine_packed_keyshares(uint8_t (*keys)[32],
+                                  uint8_t l,
+                                  const sss_Keyshare *shares,
+                                  uint8_t k);
+
+
+/*
+ * A reusable workspace for the create and combine functions.
+ *
+ * The `_ctx` variants of the functions in this library do not allocate any
+ * variable-length buffers on the stack. Instead, they use the scratch space
+ * in a workspace that the caller allocates once (with `sss_ctx_new`) and
+ * then reuses for as many calls as needed. This keeps the memory usage of
+ * every call fixed, which matters on small (fiber or coroutine) stacks.
+ *
+ * A workspace may only be used by one thread at a time.
+ */
+typedef struct sss_Ctx sss_Ctx;
+
+
+/*
+ * Allocate a new workspace that can create at most `n_max` shares with a
+ * threshold of at most `k_max`, and that can combine at most `k_max` shares.
+ *
+ * Returns NULL if the memory could not be allocated.
+ */
+sss_Ctx* sss_ctx_new(uint8_t n_max, uint8_t k_max);
+
+
+/*
+ * Same as `sss_ctx_new`, but take the workspace from the secure memory arena
+ * `arena`, so that the polynomial coefficients and intermediate values never
+ * end up in swap or core dumps. The memory is returned to the arena when it is
+ * released or reset (not by `sss_ctx_free`).
+ *
+ * Returns NULL if the arena does not have enough space left.
+ */
+sss_Ctx* sss_ctx_new_in(sss_Arena *arena, uint8_t n_max, uint8_t k_max);
+
+
+/*
+ * Return the amount of arena memory that `sss_ctx_new_in` takes for a
+ * workspace with the limits `n_max` and `k_max`, so that an arena can be
+ * sized to fit a number of workspaces.
+ */
+size_t sss_ctx_arena_size(uint8_t n_max, uint8_t k_max);
+
+
+/*
+ * Wipe all of the scratch space in `ctx` and free it (unless it was taken
+ * from an arena).
+ */
+void sss_ctx_free(sss_Ctx *ctx);
+
+
+/*
+ * Return a scratch buffer in `ctx` that fits `max(n_max, k_max)` key shares.
+ * The functions in this file leave this buffer alone; it is meant for the
+ * intermediate level API.
+ */
+sss_Keyshare* sss_ctx_keyshares(sss_Ctx *ctx);
+
+
+/*
+ * Return a scratch buffer in `ctx` of `sss_CTX_SECRET_LEN` bytes. It is used
+ * by the `_ctx` functions in `sss.h` for the ephemeral key and the plaintext,
+ * so that these are locked as well if `ctx` lives in an arena.
+ */
+uint8_t* sss_ctx_secret(sss_Ctx *ctx);
+
+
+/*
+ * If `enable` is nonzero, let `ctx` read randomness from the OS in blocks of
+ * `sss_CTX_RNG_LEN` bytes, instead of doing a system call for every create
+ * call. The randomness is kept in the workspace (so it is locked if `ctx`
+ * lives in an arena) and every byte is wiped as soon as it is used.
+ *
+ * A workspace with buffered randomness must not be used in both the parent
+ * and the child process after a fork, because they would create the same
+ * polynomials.
+ */
+void sss_ctx_buffer_randomness(sss_Ctx *ctx, int enable);
+
+
+/*
+ * Fill `buf` with `len` random bytes, using the randomness buffer of `ctx`
+ * if it is enabled.
+ */
+void sss_ctx_randombytes(sss_Ctx *ctx, void *buf, size_t len);
+
+
+/*
+ * Let the `_ctx` functions spread their work over the workers in
+ * `threadpool`, if the amount of work is at least `sss_MT_THRESHOLD`. Pass
+ * NULL to go back to running everything on the calling thread.
+ *
+ * The thread pool is not owned by `ctx`, and may be shared between multiple
+ * workspaces.
+ */
+void sss_ctx_set_threadpool(sss_Ctx *ctx, sss_Threadpool *threadpool);
+
+
+/*
+ * Same as `sss_create_keyshares`, but using the workspace in `ctx`.
+ */
+void sss_create_keyshares_ctx(sss_Ctx *ctx,
+                              sss_Keyshare *out,
+                              const uint8_t key[32],
+                              uint8_t n,
+                              uint8_t k);
+
+
+/*
+ * Same as `sss_combine_keyshares`, but using the workspace in `ctx`.
+ *
+ * The workspace remembers the Lagrange weights for the last set of x values
+ * that was combined. Combining another set of shares with the same x values
+ * (in the same order) skips the computation of the weights, which makes the
+ * combine step O(k) instead of O(k^2). The x values of the shares are treated
+ * as public values.
+ */
+void sss_combine_keyshares_ctx(sss_Ctx *ctx,
+                               uint8_t key[32],
+                               const sss_Keyshare *shares,
+                               uint8_t k);
+
+
+/*
+ * Resharing moves a key from a k-of-n policy to a k2-of-n2 policy, without
+ * restoring the key. It works in two steps:
+ *
+ *  1. Each of `k` old holders calls `sss_reshare_keyshare` on their share,
+ *     and sends the sub-share with x value `j` to the new holder `j`.
+ *  2. Each new holder calls `sss_combine_subshares` on the `k` sub-shares
+ *     that they received, which gives them their new share.
+ *
+ * The old shares cannot be combined with the new shares.
+ */
+void sss_reshare_keyshare(sss_Keyshare *out,
+                          const sss_Keyshare share,
+                          uint8_t n2,
+                          uint8_t k2);
+
+
+/*
+ * Combine the `k` sub-shares in `subshares` into a new share, and write it to
+ * `out`. The sub-share in `subshares[i]` must have been made from the old
+ * share with x value `old_xs[i]`.
+ *
+ * Returns 0 on success, and -1 if the sub-shares do not all have the same x
+ * value (in which case nothing is written to `out`).
+ */
+int sss_combine_subshares(sss_Keyshare out,
+                          const sss_Keyshare *subshares,
+                          const uint8_t *old_xs,
+                          uint8_t k);
+
+
+/*
+ * Run the whole resharing protocol for the `k` shares in `shares`, and write
+ * the `n2` new shares (with a threshold of `k2`) to `out`. This gives the
+ * same result as steps 1 and 2 above, but computes the Lagrange weights only
+ * once and never materializes the sub-shares.
+ */
+void sss_reshare_keyshares(sss_Keyshare *out,
+                           const sss_Keyshare *shares,
+                           uint8_t k,
+                           uint8_t n2,
+                           uint8_t k2);
+
+
+/*
+ * Same as `sss_reshare_keyshares`, but using the workspace in `ctx`, which
+ * must have been allocated with `n_max >= n2`, `k_max >= k` and
+ * `k_max >= k2`. Like `sss_combine_keyshares_ctx`, the workspace remembers
+ * the Lagrange weights for the x values of the old shares. `out` is allowed
+ * to overlap with `shares`.
+ */
+void sss_reshare_keyshares_ctx(sss_Ctx *ctx,
+                               sss_Keyshare *out,
+                               const sss_Keyshare *shares,
+                               uint8_t k,
+                               uint8_t n2,
+                               uint8_t k2);
+
+
+/*
+ * Refresh the `n` shares in `shares` that were created with a threshold of
+ * `k`, by adding the shares of a fresh random polynomial with a zero constant
+ * term. The refreshed shares restore the same key, but cannot be combined
+ * with any of the old shares. Shares that leaked before the refresh become
+ * useless, unless `k` of them leaked.
+ *
+ * The shares can have any x values. The key is never restored during the
+ * refresh.
+ */
+void sss_refresh_keyshares(sss_Keyshare *shares, uint8_t n, uint8_t k);
+
+
+/*
+ * Same as `sss_refresh_keyshares`, but using the workspace in `ctx`.
+ */
+void sss_refresh_keyshares_ctx(sss_Ctx *ctx,
+                               sss_Keyshare *shares,
+                               uint8_t n,
+                               uint8_t k);
+
+
+/*
+ * Combine the `n` shares in `shares` that were created with a threshold of
+ * `k`, correcting any faulty shares on the way, and write the resulting key
+ * to `key`.
+ *
+ * The shares are decoded as a Reed-Solomon codeword (syndrome decoding with
+ * the Berlekamp-Massey algorithm), so this works as long as at most
+ * (n - k) / 2 of the shares are faulty. The indices (into `shares`) of the
+ * faulty shares are written to `faulty`, which must have room for `n`
+ * indices.
+ *
+ * Returns the amount of faulty shares on success. Returns -1 if there were
+ * too many faulty shares to restore the key, or if two of the shares have the
+ * same x value; in that case, nothing is written to `key`.
+ *
+ * This function treats the y values of the shares as secret values, but the
+ * x values, `n`, `k`, and which of the shares are faulty as public values.
+ */
+int sss_combine_keyshares_robust(uint8_t key[32],
+                                 uint8_t *faulty,
+                                 const sss_Keyshare *shares,
+                                 uint8_t n,
+                                 uint8_t k);
+
+
+/*
+ * State for combining key shares one at a time, as they arrive.
+ *
+ * Every share that is added does O(k) work, so that the secret is known as
+ * soon as the last share arrives, instead of doing O(k^2) work after all of
+ * the shares are present.
+ */
+typedef struct sss_KeyshareCombiner sss_KeyshareCombiner;
+
+
+/*
+ * Allocate a new incremental combiner for at most `k` shares.
+ *
+ * Returns NULL if the memory could not be allocated.
+ */
+sss_KeyshareCombiner* sss_keyshare_combiner_new(uint8_t k);
+
+
+/*
+ * Add the key share `share` to `combiner`.
+ *
+ * Returns 0 on success. Returns -1 (without changing the state) if the
+ * combiner already holds `k` shares, if the x value of `share` is invalid,
+ * or if a share with the same x value was already added.
+ *
+ * The y value of `share` is treated as a secret value. The x value is treated
+ * as a public value.
+ */
+int sss_keyshare_combiner_add(sss_KeyshareCombiner *combiner,
+                              const sss_Keyshare share);
+
+
+/*
+ * Return the amount of shares that have been added to `combiner`.
+ */
+uint8_t sss_keyshare_combiner_count(const sss_KeyshareCombiner *combiner);
+
+
+/*
+ * Write the key that is restored from the shares added so far to `key`. This
+ * is O(1). The same caveats apply as for `sss_combine_keyshares`.
+ */
+void sss_keyshare_combiner_finalize(const sss_KeyshareCombiner *combiner,
+                                    uint8_t key[32]);
+
+
+/*
+ * Evaluate the polynomial through the shares added so far at the x value `x`,
+ * and write the resulting key share to `out`. This costs O(k), so it can be
+ * used to check surplus shares against the restored polynomial, or to create
+ * a new share for `x`.
+ */
+void sss_keyshare_combiner_eval(const sss_KeyshareCombiner *combiner,
+                                sss_Keyshare out,
+                                uint8_t x);
+
+
+/*
+ * Wipe the state of `combiner` and free it.
+ */
+void sss_keyshare_combiner_free(sss_KeyshareCombiner *combiner);
+
+
+/*
+ * A dealer-side handle that keeps a sharing polynomial around, so that shares
+ * can be created one at a time, for any x value, whenever they are needed.
+ *
+ * The random coefficients of the polynomial are derived from a 32-byte seed
+ * and the key. Given the key and the seed, the exact same polynomial can be
+ * rebuilt, so a lost share can be issued again without restoring the key from
+ * other shares. The seed must be treated as a secret value, and a seed must
+ * never be reused for a different key.
+ */
+typedef struct sss_KeyshareGenerator sss_KeyshareGenerator;
+
+
+/*
+ * Create a generator for shares of `key` with a treshold value given in `k`.
+ * If `seed` is NULL, a random seed is generated. If `arena` is not NULL, the
+ * polynomial is kept in (locked) memory from `arena`.
+ *
+ * Returns NULL if the memory could not be allocated.
+ */
+sss_KeyshareGenerator* sss_keyshare_generator_new(sss_Arena *arena,
+                                                  const uint8_t key[32],
+                                                  const uint8_t seed[32],
+                                                  uint8_t k);
+
+
+/*
+ * Write the seed of `gen` to `seed`.
+ */
+void sss_keyshare_generator_seed(const sss_KeyshareGenerator *gen,
+                                 uint8_t seed[32]);
+
+
+/*
+ * Create the key share with x value `x` and write it to `out`. This costs
+ * O(k) and does not allocate any memory.
+ *
+ * Returns 0 on success, and -1 if `x` is 0.
+ */
+int sss_keyshare_generator_get(const sss_KeyshareGenerator *gen,
+                               sss_Keyshare out,
+                               uint8_t x);
+
+
+/*
+ * Wipe the polynomial in `gen` and free it (unless it was taken from an
+ * arena).
+ */
+void sss_keyshare_generator_free(sss_KeyshareGenerator *gen);
+
+
+/*
+ * A key share in the bitsliced form that this module computes with. Chaining
+ * the `_bitsliced` functions below skips the conversion from and to
+ * `sss_Keyshare` at every step, so only convert at the storage or wire
+ * boundary. The layout of this struct is private and may change between
+ * versions, so never store or send it.
+ */
+typedef struct {
+	uint32_t y[8];
+	uint32_t x;
+} sss_BitslicedKeyshare;
+
+
+/*
+ * Convert the `n` shares in `in` to the bitsliced form.
+ */
+void sss_bitslice_keyshares(sss_BitslicedKeyshare *out,
+                            const sss_Keyshare *in,
+                            size_t n);
+
+
+/*
+ * Convert the `n` bitsliced shares in `in` back to `sss_Keyshare`.
+ */
+void sss_unbitslice_keyshares(sss_Keyshare *out,
+                              const sss_BitslicedKeyshare *in,
+                              size_t n);
+
+
+/*
+ * Same as `sss_create_keyshares`, but write bitsliced shares.
+ */
+void sss_create_keyshares_bitsliced(sss_BitslicedKeyshare *out,
+                                    const uint8_t key[32],
+                                    uint8_t n,
+                                    uint8_t k);
+
+
+/*
+ * Same as `sss_refresh_keyshares`, but on bitsliced shares.
+ */
+void sss_refresh_keyshares_bitsliced(sss_BitslicedKeyshare *shares,
+                                     uint8_t n,
+                                     uint8_t k);
+
+
+/*
+ * Same as `sss_combine_keyshares`, but on bitsliced shares.
+ */
+void sss_combine_keyshares_bitsliced(uint8_t key[32],
+                                     const sss_BitslicedKeyshare *shares,
+                                     uint8_t k);
+
+
 #endif /* sss_HAZMAT_H_ */
@@ -0,0 +1,303 @@
+/*
+ * Implementation of the hazardous parts of the SSS library, in GF(2^16)
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * A 32-byte key holds 16 elements of GF(2^16), so we bitslice a key into 16
+ * planes of 16 bits. Element `i` of a key is made from bytes `2i` and
+ * `2i + 1` (little endian), and plane `b` holds bit `b` of every element. The
+ * field is GF(2)[x] / (x^16 + x^12 + x^3 + x + 1).
+ *
+ * All of the operations on the y values (which are secret) are bitsliced, and
+ * are therefore constant time. The x values and the Lagrange weights are
+ * public, so they are handled with scalar arithmetic. Still, the scalar
+ * arithmetic does not branch on its inputs either.
+ */
+
+
+#include "randombytes.h"
+#include "arena.h"
+#include "hazmat16.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * The reduction polynomial without the x^16 term
+ */
+#define GF65536_POLY 0x100B
+
+
+/*
+ * Convert a 32-byte array into 16 bitsliced planes
+ */
+static void
+bitslice16(uint16_t r[16], const uint8_t x[32])
+{
+	size_t bit_idx, arr_idx;
+	uint16_t cur;
+
+	memset(r, 0, sizeof(uint16_t[16]));
+	for (arr_idx = 0; arr_idx < 16; arr_idx++) {
+		cur = (uint16_t) x[2 * arr_idx] | (uint16_t) x[2 * arr_idx + 1] << 8;
+		for (bit_idx = 0; bit_idx < 16; bit_idx++) {
+			r[bit_idx] |= ((cur >> bit_idx) & 1) << arr_idx;
+		}
+	}
+}
+
+
+/*
+ * Convert 16 bitsliced planes back into a 32-byte array
+ */
+static void
+unbitslice16(uint8_t r[32], const uint16_t x[16])
+{
+	size_t bit_idx, arr_idx;
+	uint16_t cur;
+
+	for (arr_idx = 0; arr_idx < 16; arr_idx++) {
+		cur = 0;
+		for (bit_idx = 0; bit_idx < 16; bit_idx++) {
+			cur |= ((x[bit_idx] >> arr_idx) & 1) << bit_idx;
+		}
+		r[2 * arr_idx] = cur & 0xFF;
+		r[2 * arr_idx + 1] = cur >> 8;
+	}
+}
+
+
+/*
+ * Set all 16 elements of `r` to the value `x`
+ */
+static void
+bitslice16_setall(uint16_t r[16], uint16_t x)
+{
+	size_t idx;
+	for (idx = 0; idx < 16; idx++) {
+		r[idx] = -((x >> idx) & 1);
+	}
+}
+
+
+/*
+ * Add (XOR) `x` to `r`
+ */
+static void
+gf65536_add(uint16_t r[16], const uint16_t x[16])
+{
+	size_t idx;
+	for (idx = 0; idx < 16; idx++) r[idx] ^= x[idx];
+}
+
+
+/*
+ * Multiply `a` and `b` and write the result to `r` (which may be `a` or `b`).
+ *
+ * Like `gf256_mul` in `hazmat.c` this is Russian Peasant multiplication, but
+ * with 16 planes the unrolled version would be too long to read, so we leave
+ * the unrolling to the compiler.
+ */
+static void
+gf65536_mul(uint16_t r[16], const uint16_t a[16], const uint16_t b[16])
+{
+	uint16_t a2[16], acc[16] = { 0 }, carry;
+	size_t bit_idx, idx;
+
+	memcpy(a2, a, sizeof(a2));
+	for (bit_idx = 0; bit_idx < 16; bit_idx++) {
+		for (idx = 0; idx < 16; idx++) acc[idx] ^= a2[idx] & b[bit_idx];
+
+		/* a2 = a2 * x mod (x^16 + x^12 + x^3 + x + 1) */
+		carry = a2[15];
+		memmove(&a2[1], &a2[0], 15 * sizeof(uint16_t));
+		a2[0] = carry;
+		a2[1] ^= carry;
+		a2[3] ^= carry;
+		a2[12] ^= carry;
+	}
+	memcpy(r, acc, sizeof(acc));
+}
+
+
+/*
+ * Multiply two (unbitsliced) field elements
+ */
+static uint16_t
+gf65536_mul_scalar(uint16_t a, uint16_t b)
+{
+	uint16_t r = 0;
+	size_t idx;
+
+	for (idx = 0; idx < 16; idx++) {
+		r ^= a & -((b >> idx) & 1);
+		a = (a << 1) ^ (GF65536_POLY & -(a >> 15));
+	}
+	return r;
+}
+
+
+/*
+ * Invert an (unbitsliced) field element, as x^(2^16 - 2). Zero is mapped to
+ * zero.
+ */
+static uint16_t
+gf65536_inv_scalar(uint16_t x)
+{
+	uint16_t r, sq;
+	size_t idx;
+
+	/* 2^16 - 2 = 2 + 4 + ... + 2^15 */
+	sq = gf65536_mul_scalar(x, x);
+	r = sq;
+	for (idx = 2; idx < 16; idx++) {
+		sq = gf65536_mul_scalar(sq, sq);
+		r = gf65536_mul_scalar(r, sq);
+	}
+	return r;
+}
+
+
+uint16_t
+sss_keyshare16_x(const sss_Keyshare16 share)
+{
+	return (uint16_t) share[0] << 8 | share[1];
+}
+
+
+int
+sss_create_keyshares16(sss_Keyshare16 *out,
+                       const uint8_t key[32],
+                       uint16_t n,
+                       uint16_t k)
+{
+	uint16_t (*poly)[16], x[16], y[16];
+	size_t share_idx, coeff_idx;
+
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+
+	poly = malloc(k * sizeof(uint16_t[16]));
+	if (poly == NULL) return -1;
+
+	/* The key is the constant term, the other terms are random */
+	bitslice16(poly[0], key);
+	randombytes((void*) poly[1], (k-1) * sizeof(uint16_t[16]));
+
+	/* Horner's method, at x = 1..n */
+	for (share_idx = 0; share_idx < n; share_idx++) {
+		bitslice16_setall(x, share_idx + 1);
+		memcpy(y, poly[k - 1], sizeof(y));
+		for (coeff_idx = k - 1; coeff_idx > 0; coeff_idx--) {
+			gf65536_mul(y, y, x);
+			gf65536_add(y, poly[coeff_idx - 1]);
+		}
+		out[share_idx][0] = (share_idx + 1) >> 8;
+		out[share_idx][1] = (share_idx + 1) & 0xFF;
+		unbitslice16(&out[share_idx][2], y);
+	}
+	sss_memzero(poly, k * sizeof(uint16_t[16]));
+	sss_memzero(y, sizeof(y));
+	free(poly);
+	return 0;
+}
+
+
+int
+sss_lagrange_weights16(uint16_t *weights,
+                       const uint16_t *xs,
+                       uint16_t k)
+{
+	uint16_t *prefix, num = 1, tmp, inv;
+	size_t idx1, idx2;
+
+	assert(k != 0);
+
+	prefix = malloc(k * sizeof(uint16_t));
+	if (prefix == NULL) return -1;
+
+	/*
+	 * The weight of share i is
+	 *
+	 *     w_i = prod_{j != i} x_j / (x_i - x_j) = (X / x_i) / d_i
+	 *
+	 * with X the product of all x values. First, put the denominators
+	 * x_i * d_i in `weights`.
+	 */
+	for (idx1 = 0; idx1 < k; idx1++) {
+		num = gf65536_mul_scalar(num, xs[idx1]);
+	}
+	for (idx1 = 0; idx1 < k; idx1++) {
+		tmp = xs[idx1];
+		for (idx2 = 0; idx2 < k; idx2++) {
+			if (idx1 == idx2) continue;
+			tmp = gf65536_mul_scalar(tmp, xs[idx1] ^ xs[idx2]);
+		}
+		weights[idx1] = tmp;
+	}
+
+	/* Montgomery's trick: invert all of the denominators at once */
+	tmp = 1;
+	for (idx1 = 0; idx1 < k; idx1++) {
+		prefix[idx1] = tmp;
+		tmp = gf65536_mul_scalar(tmp, weights[idx1]);
+	}
+	if (tmp == 0) {
+		/* Duplicate x values, or an x value of 0 */
+		free(prefix);
+		return -1;
+	}
+	inv = gf65536_inv_scalar(tmp);
+	for (idx1 = k; idx1-- > 0;) {
+		tmp = gf65536_mul_scalar(inv, prefix[idx1]);
+		inv = gf65536_mul_scalar(inv, weights[idx1]);
+		weights[idx1] = gf65536_mul_scalar(num, tmp);
+	}
+	free(prefix);
+	return 0;
+}
+
+
+void
+sss_combine_keyshares16_weights(uint8_t key[32],
+                                const sss_Keyshare16 *shares,
+                                const uint16_t *weights,
+                                uint16_t k)
+{
+	uint16_t w[16], y[16], secret[16] = { 0 };
+	size_t idx;
+
+	for (idx = 0; idx < k; idx++) {
+		bitslice16_setall(w, weights[idx]);
+		bitslice16(y, &shares[idx][2]);
+		gf65536_mul(y, y, w);
+		gf65536_add(secret, y);
+	}
+	unbitslice16(key, secret);
+	sss_memzero(y, sizeof(y));
+	sss_memzero(secret, sizeof(secret));
+}
+
+
+int
+sss_combine_keyshares16(uint8_t key[32],
+                        const sss_Keyshare16 *shares,
+                        uint16_t k)
+{
+	uint16_t *weights, *xs;
+	size_t idx;
+	int ret;
+
+	weights = malloc(2 * k * sizeof(uint16_t));
+	if (weights == NULL) return -1;
+	xs = &weights[k];
+	for (idx = 0; idx < k; idx++) {
+		xs[idx] = sss_keyshare16_x(shares[idx]);
+	}
+	ret = sss_lagrange_weights16(weights, xs, k);
+	if (ret == 0) sss_combine_keyshares16_weights(key, shares, weights, k);
+	free(weights);
+	return ret;
+}
@@ -0,0 +1,91 @@
+/*
+ * Low level API for Daan Sprenkels' Shamir secret sharing library, in
+ * GF(2^16)
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * This is the same scheme as in `hazmat.h`, but over GF(2^16) with 2-byte x
+ * values, so that up to 65535 shares can be created. The same warnings apply
+ * as for `hazmat.h`.
+ */
+
+
+#ifndef sss_HAZMAT16_H_
+#define sss_HAZMAT16_H_
+
+#include <inttypes.h>
+
+
+#define sss_KEYSHARE16_LEN 34 /* 2 + 32 */
+
+
+/*
+ * One share of a cryptographic key which is shared using Shamir's
+ * the `sss_create_keyshares16` function. The x value is stored in the first
+ * two bytes (big endian).
+ */
+typedef uint8_t sss_Keyshare16[sss_KEYSHARE16_LEN];
+
+
+/*
+ * Return the x value of `share`.
+ */
+uint16_t sss_keyshare16_x(const sss_Keyshare16 share);
+
+
+/*
+ * Share the secret given in `key` into `n` shares with a treshold value given
+ * in `k`. The resulting shares are written to `out`, which must fit at least
+ * `n` sss_Keyshare16 structs.
+ *
+ * The scratch space is taken from the heap, because it is too large for the
+ * stack when `k` is large. Returns 0 on success, and -1 if the scratch space
+ * could not be allocated.
+ */
+int sss_create_keyshares16(sss_Keyshare16 *out,
+                           const uint8_t key[32],
+                           uint16_t n,
+                           uint16_t k);
+
+
+/*
+ * Compute the Lagrange weights for the `k` x values in `xs` and write them to
+ * `weights`. The weights only depend on the x values (which are public), so
+ * they can be computed once and used to combine the shares of any number of
+ * keys that were given to the same holders, with
+ * `sss_combine_keyshares16_weights`.
+ *
+ * This costs O(k^2) multiplications, but only a single inversion.
+ *
+ * Returns 0 on success, and -1 if any of the x values is 0, if two of them
+ * are the same, or if the scratch space could not be allocated.
+ */
+int sss_lagrange_weights16(uint16_t *weights,
+                           const uint16_t *xs,
+                           uint16_t k);
+
+
+/*
+ * Restore the key from the `k` shares in `shares` and write it to `key`,
+ * using the weights that were computed by `sss_lagrange_weights16` for the x
+ * values of these shares (in the same order). This is O(k).
+ *
+ * The same caveats apply as for `sss_combine_keyshares` in `hazmat.h`.
+ */
+void sss_combine_keyshares16_weights(uint8_t key[32],
+                                     const sss_Keyshare16 *shares,
+                                     const uint16_t *weights,
+                                     uint16_t k);
+
+
+/*
+ * Restore the key from the `k` shares in `shares` and write it to `key`.
+ *
+ * Returns 0 on success, and -1 if two of the shares have the same x value or
+ * if the scratch space could not be allocated.
+ */
+int sss_combine_keyshares16(uint8_t key[32],
+                            const sss_Keyshare16 *shares,
+                            uint16_t k);
+
+
+#endif /* sss_HAZMAT16_H_ */
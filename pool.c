@@ -0,0 +1,294 @@
+/*
+ * Precomputation pool for dealing shares
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * A dealing ticket consists of shares of a random polynomial with a zero
+ * constant term (see `sss_precompute_keyshares`), a fresh ephemeral key, and
+ * the first `32 + sss_MLEN` bytes of the xsalsa20 keystream under that key.
+ * The first 32 bytes of the keystream are the poly1305 key that is used by
+ * `crypto_secretbox`; the rest is XOR'ed with the message. The online path
+ * only adds the key to the shares (`sss_apply_keyshares`), encrypts and
+ * authenticates, so a ticket produces exactly the same kind of shares as
+ * `sss_create_shares`.
+ *
+ * Tickets are stored in a ring buffer which is protected by a mutex. The
+ * producers (the background thread and `sss_pool_refill`) build a ticket in a
+ * staging buffer, which is protected by a second mutex, so that the online
+ * path never has to wait for a ticket to be computed. A consumer only claims
+ * a ticket under the mutex, by marking its slot as busy, and uses it after
+ * unlocking, so consumers do not wait for each other's online work. A
+ * producer does not refill a busy slot. All of the tickets live in a secure
+ * memory arena (see arena.h).
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "randombytes.h"
+#include "tweetnacl.h"
+#include "arena.h"
+#include "pool.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#if crypto_onetimeauth_KEYBYTES != 32 || crypto_onetimeauth_BYTES != 16
+# error "crypto_onetimeauth sizes are invalid"
+#endif
+
+
+struct sss_Pool {
+	uint8_t n, k;
+	size_t capacity, ticket_len, mem_len;
+	size_t head, count;
+	sss_Arena *arena;
+	uint8_t *mem; /* staging ticket followed by `capacity` tickets */
+	uint8_t *busy; /* slots whose ticket is being used outside the lock */
+	int running, stop;
+	pthread_t thread;
+	pthread_mutex_t lock, fill_lock;
+	pthread_cond_t cond;
+};
+
+
+/*
+ * Nonce for the `crypto_secretbox` authenticated encryption (see sss.c)
+ */
+static const unsigned char nonce[crypto_secretbox_NONCEBYTES] = { 0 };
+
+
+static uint8_t* staging(sss_Pool *pool)
+{
+	return pool->mem;
+}
+
+
+static uint8_t* slot(sss_Pool *pool, size_t idx)
+{
+	return &pool->mem[(1 + idx % pool->capacity) * pool->ticket_len];
+}
+
+
+/*
+ * A ticket is laid out as | keyshares | key | keystream |
+ */
+static uint8_t* ticket_key(const sss_Pool *pool, uint8_t *ticket)
+{
+	return &ticket[pool->n * sss_KEYSHARE_LEN];
+}
+
+
+static uint8_t* ticket_stream(const sss_Pool *pool, uint8_t *ticket)
+{
+	return &ticket[pool->n * sss_KEYSHARE_LEN + crypto_secretbox_KEYBYTES];
+}
+
+
+/*
+ * Compute a fresh ticket and write it to `ticket`
+ */
+static void make_ticket(const sss_Pool *pool, uint8_t *ticket)
+{
+	uint8_t *key = ticket_key(pool, ticket);
+
+	sss_precompute_keyshares((sss_Keyshare*) ticket, pool->n, pool->k);
+	randombytes(key, crypto_secretbox_KEYBYTES);
+	crypto_stream(ticket_stream(pool, ticket), 32 + sss_MLEN, nonce, key);
+}
+
+
+/*
+ * Deal the shares of `data` using `ticket` and wipe the ticket
+ */
+static void use_ticket(const sss_Pool *pool, uint8_t *ticket,
+                       sss_Share *out, const uint8_t *data)
+{
+	const uint8_t *stream = ticket_stream(pool, ticket);
+	uint8_t c[sss_CLEN];
+	size_t idx;
+
+	/* Turn the precomputed shares into shares of the ephemeral key */
+	sss_apply_keyshares((sss_Keyshare*) ticket, ticket_key(pool, ticket),
+	                    pool->n);
+
+	/* Encrypt the data and compute the MAC, like `crypto_secretbox` */
+	for (idx = 0; idx < sss_MLEN; idx++) {
+		c[16 + idx] = data[idx] ^ stream[32 + idx];
+	}
+	crypto_onetimeauth(c, &c[16], sss_MLEN, stream);
+
+	/* Build regular shares */
+	for (idx = 0; idx < pool->n; idx++) {
+		memcpy(&out[idx][0], &ticket[idx * sss_KEYSHARE_LEN],
+		       sss_KEYSHARE_LEN);
+		memcpy(&out[idx][sss_KEYSHARE_LEN], c, sss_CLEN);
+	}
+	sss_memzero(ticket, pool->ticket_len);
+}
+
+
+/*
+ * Compute one ticket and put it in the pool. Returns 0 if the pool was
+ * already full.
+ */
+static int produce(sss_Pool *pool)
+{
+	int added = 0;
+
+	pthread_mutex_lock(&pool->fill_lock);
+	make_ticket(pool, staging(pool));
+	pthread_mutex_lock(&pool->lock);
+	while (pool->count < pool->capacity &&
+	       pool->busy[(pool->head + pool->count) % pool->capacity]) {
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	if (pool->count < pool->capacity) {
+		memcpy(slot(pool, pool->head + pool->count), staging(pool),
+		       pool->ticket_len);
+		pool->count++;
+		added = 1;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	sss_memzero(staging(pool), pool->ticket_len);
+	pthread_mutex_unlock(&pool->fill_lock);
+	return added;
+}
+
+
+static void* background(void *arg)
+{
+	sss_Pool *pool = arg;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		while (pool->count == pool->capacity && !pool->stop) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		}
+		if (pool->stop) {
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&pool->lock);
+		produce(pool);
+	}
+}
+
+
+sss_Pool* sss_pool_new(uint8_t n, uint8_t k, size_t capacity)
+{
+	sss_Pool *pool;
+
+	assert(n != 0);
+	assert(k != 0);
+	assert(k <= n);
+	assert(capacity != 0);
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) return NULL;
+	pool->busy = calloc(capacity, 1);
+	if (pool->busy == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pool->n = n;
+	pool->k = k;
+	pool->capacity = capacity;
+	pool->ticket_len = n * sss_KEYSHARE_LEN + crypto_secretbox_KEYBYTES +
+	                   32 + sss_MLEN;
+	pool->mem_len = (capacity + 1) * pool->ticket_len;
+	pool->arena = sss_arena_new(pool->mem_len);
+	if (pool->arena == NULL) {
+		free(pool->busy);
+		free(pool);
+		return NULL;
+	}
+	pool->mem = sss_arena_alloc(pool->arena, pool->mem_len);
+	assert(pool->mem != NULL);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_init(&pool->fill_lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+	return pool;
+}
+
+
+int sss_pool_start(sss_Pool *pool)
+{
+	if (pool->running) return 0;
+	if (pthread_create(&pool->thread, NULL, background, pool) != 0) {
+		return -1;
+	}
+	pool->running = 1;
+	return 0;
+}
+
+
+void sss_pool_refill(sss_Pool *pool)
+{
+	while (produce(pool));
+}
+
+
+size_t sss_pool_available(sss_Pool *pool)
+{
+	size_t count;
+
+	pthread_mutex_lock(&pool->lock);
+	count = pool->count;
+	pthread_mutex_unlock(&pool->lock);
+	return count;
+}
+
+
+void sss_pool_create_shares(sss_Pool *pool,
+                            sss_Share *out,
+                            const uint8_t *data)
+{
+	size_t idx;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->count > 0) {
+		/* Claim the ticket, and use it without holding the lock */
+		idx = pool->head;
+		pool->busy[idx] = 1;
+		pool->head = (pool->head + 1) % pool->capacity;
+		pool->count--;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+		use_ticket(pool, slot(pool, idx), out, data);
+
+		/* Hand the slot back to the producers */
+		pthread_mutex_lock(&pool->lock);
+		pool->busy[idx] = 0;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Pool is empty, so compute the ticket on the spot */
+	pthread_mutex_lock(&pool->fill_lock);
+	make_ticket(pool, staging(pool));
+	use_ticket(pool, staging(pool), out, data);
+	pthread_mutex_unlock(&pool->fill_lock);
+}
+
+
+void sss_pool_free(sss_Pool *pool)
+{
+	if (pool == NULL) return;
+	if (pool->running) {
+		pthread_mutex_lock(&pool->lock);
+		pool->stop = 1;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+		pthread_join(pool->thread, NULL);
+	}
+	sss_arena_free(pool->arena);
+	free(pool->busy);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->fill_lock);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
@@ -0,0 +1,81 @@
+/*
+ * Precomputation pool for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Almost all of the work done by `sss_create_shares` does not depend on the
+ * secret data: generating the ephemeral key, sharing that key and computing
+ * the AEAD keystream. A pool does this work ahead of time (optionally on a
+ * background thread) and stores the results as "dealing tickets". Dealing
+ * with a ticket only has to encrypt and authenticate the data.
+ */
+
+
+#ifndef sss_POOL_H_
+#define sss_POOL_H_
+
+#include "sss.h"
+#include <stddef.h>
+
+
+/*
+ * A pool of precomputed dealing tickets for a fixed `n` and `k`.
+ */
+typedef struct sss_Pool sss_Pool;
+
+
+/*
+ * Allocate a new pool that holds at most `capacity` tickets for dealing `n`
+ * shares with a threshold of `k`. The tickets are stored in locked memory
+ * when the platform allows it.
+ *
+ * The pool starts out empty. Fill it using `sss_pool_refill` or let a
+ * background thread do that using `sss_pool_start`.
+ *
+ * Returns NULL if the memory could not be allocated.
+ */
+sss_Pool* sss_pool_new(uint8_t n, uint8_t k, size_t capacity);
+
+
+/*
+ * Start a background thread that keeps the pool filled.
+ *
+ * Returns 0 on success, and a nonzero value if the thread could not be
+ * started.
+ */
+int sss_pool_start(sss_Pool *pool);
+
+
+/*
+ * Fill the pool up to its capacity from the calling thread. This can be used
+ * instead of `sss_pool_start` to do the precomputation at a moment that suits
+ * the caller.
+ */
+void sss_pool_refill(sss_Pool *pool);
+
+
+/*
+ * Return the amount of tickets that are currently ready in the pool.
+ */
+size_t sss_pool_available(sss_Pool *pool);
+
+
+/*
+ * Create shares of the secret data `data`, exactly like `sss_create_shares`
+ * with the `n` and `k` values of `pool`, and write them to `out`.
+ *
+ * If the pool is empty, the ticket is computed on the spot. The resulting
+ * shares are the same, but the call is just as slow as `sss_create_shares`.
+ */
+void sss_pool_create_shares(sss_Pool *pool,
+                            sss_Share *out,
+                            const uint8_t *data);
+
+
+/*
+ * Stop the background thread (if any), wipe all of the remaining tickets and
+ * free the pool.
+ */
+void sss_pool_free(sss_Pool *pool);
+
+
+#endif /* sss_POOL_H_ */
@@ -0,0 +1,59 @@
+/*
+ * Static tracepoints for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * When `<sys/sdt.h>` is available (from systemtap-sdt-dev or
+ * systemtap-sdt-devel), the library contains USDT probes under the provider
+ * `sss`, which can be attached to with perf, bpftrace or systemtap without
+ * rebuilding or restarting the process. For example:
+ *
+ *     bpftrace -e 'usdt:./prog:sss:combine_shares__return { @[arg2] = count(); }'
+ *
+ * An unused probe is a single NOP instruction. The probes only pass the
+ * parameters and results of a call, never any secret material:
+ *
+ *     create_shares__entry      (n, k, len)
+ *     create_shares__return     (n, k, len, result)
+ *     combine_shares__entry     (k, len)
+ *     combine_shares__return    (k, len, result)
+ *     create_keyshares__entry   (n, k)
+ *     create_keyshares__return  (n, k)
+ *     combine_keyshares__entry  (k)
+ *     combine_keyshares__return (k)
+ *     aead__seal                (len, result)
+ *     aead__open                (len, result)
+ *
+ * Build with `make USDT=0` (which defines `sss_NO_USDT`) to leave the probes
+ * out, even if `<sys/sdt.h>` is available.
+ */
+
+
+#ifndef sss_PROBES_H_
+#define sss_PROBES_H_
+
+#if !defined(sss_NO_USDT) && defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  define sss_HAVE_USDT 1
+# endif
+#endif
+
+#ifdef sss_HAVE_USDT
+
+#include <sys/sdt.h>
+
+#define sss_PROBE1(name, a) DTRACE_PROBE1(sss, name, a)
+#define sss_PROBE2(name, a, b) DTRACE_PROBE2(sss, name, a, b)
+#define sss_PROBE3(name, a, b, c) DTRACE_PROBE3(sss, name, a, b, c)
+#define sss_PROBE4(name, a, b, c, d) DTRACE_PROBE4(sss, name, a, b, c, d)
+
+#else
+
+#define sss_PROBE1(name, a) ((void) 0)
+#define sss_PROBE2(name, a, b) ((void) 0)
+#define sss_PROBE3(name, a, b, c) ((void) 0)
+#define sss_PROBE4(name, a, b, c, d) ((void) 0)
+
+#endif /* sss_HAVE_USDT */
+
+
+#endif /* sss_PROBES_H_ */
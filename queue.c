@@ -0,0 +1,128 @@
+/*
+ * Bounded blocking queue
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * The items are kept in a ring buffer that is protected by one mutex. Pushes
+ * and pops move as many items as possible at once, so passing a batch of
+ * items costs one lock round trip instead of one per item.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "arena.h"
+#include "queue.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct sss_Queue {
+	size_t item_len, capacity;
+	size_t head, len; /* `len` items, starting at index `head` */
+	int closed;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty, not_full;
+	uint8_t *buf;
+};
+
+
+sss_Queue* sss_queue_new(size_t item_len, size_t capacity)
+{
+	sss_Queue *queue;
+
+	assert(item_len != 0);
+	assert(capacity != 0);
+
+	queue = calloc(1, sizeof(*queue));
+	if (queue == NULL) return NULL;
+	queue->buf = malloc(item_len * capacity);
+	if (queue->buf == NULL) {
+		free(queue);
+		return NULL;
+	}
+	queue->item_len = item_len;
+	queue->capacity = capacity;
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->not_empty, NULL);
+	pthread_cond_init(&queue->not_full, NULL);
+	return queue;
+}
+
+
+size_t sss_queue_push(sss_Queue *queue, const void *items, size_t count)
+{
+	const uint8_t *src = items;
+	size_t done = 0, tail, run;
+
+	pthread_mutex_lock(&queue->lock);
+	while (done < count) {
+		while (!queue->closed && queue->len == queue->capacity) {
+			pthread_cond_wait(&queue->not_full, &queue->lock);
+		}
+		if (queue->closed) break;
+
+		/* Copy up to the end of the free space, or of the buffer */
+		tail = (queue->head + queue->len) % queue->capacity;
+		run = queue->capacity - queue->len;
+		if (run > queue->capacity - tail) run = queue->capacity - tail;
+		if (run > count - done) run = count - done;
+		memcpy(&queue->buf[tail * queue->item_len],
+		       &src[done * queue->item_len], run * queue->item_len);
+		queue->len += run;
+		done += run;
+		pthread_cond_broadcast(&queue->not_empty);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return done;
+}
+
+
+size_t sss_queue_pop(sss_Queue *queue, void *items, size_t max)
+{
+	uint8_t *dst = items;
+	size_t done = 0, run;
+
+	pthread_mutex_lock(&queue->lock);
+	while (!queue->closed && queue->len == 0) {
+		pthread_cond_wait(&queue->not_empty, &queue->lock);
+	}
+	while (done < max && queue->len > 0) {
+		run = queue->capacity - queue->head;
+		if (run > queue->len) run = queue->len;
+		if (run > max - done) run = max - done;
+		memcpy(&dst[done * queue->item_len],
+		       &queue->buf[queue->head * queue->item_len],
+		       run * queue->item_len);
+		queue->head = (queue->head + run) % queue->capacity;
+		queue->len -= run;
+		done += run;
+	}
+	if (done > 0) pthread_cond_broadcast(&queue->not_full);
+	pthread_mutex_unlock(&queue->lock);
+	return done;
+}
+
+
+void sss_queue_close(sss_Queue *queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	queue->closed = 1;
+	pthread_cond_broadcast(&queue->not_empty);
+	pthread_cond_broadcast(&queue->not_full);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+
+void sss_queue_free(sss_Queue *queue)
+{
+	if (queue == NULL) return;
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->not_empty);
+	pthread_cond_destroy(&queue->not_full);
+	sss_memzero(queue->buf, queue->item_len * queue->capacity);
+	free(queue->buf);
+	free(queue);
+}
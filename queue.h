@@ -0,0 +1,64 @@
+/*
+ * Bounded queue for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * A blocking first-in-first-out queue of fixed-size items, for connecting the
+ * stages of a pipeline that run on different threads. The queue has a fixed
+ * capacity, so a fast stage blocks instead of running ahead of a slow stage
+ * and using up all of the memory.
+ */
+
+
+#ifndef sss_QUEUE_H_
+#define sss_QUEUE_H_
+
+#include <stddef.h>
+
+
+typedef struct sss_Queue sss_Queue;
+
+
+/*
+ * Create a new queue for up to `capacity` items of `item_len` bytes.
+ *
+ * Returns NULL if the queue could not be allocated.
+ */
+sss_Queue* sss_queue_new(size_t item_len, size_t capacity);
+
+
+/*
+ * Copy the `count` items in `items` to the back of `queue`, blocking while
+ * the queue is full. Items can be pushed from multiple threads, but the items
+ * of one call may be interleaved with the items of other calls.
+ *
+ * Returns the amount of items that were pushed, which is less than `count`
+ * only if the queue was closed.
+ */
+size_t sss_queue_push(sss_Queue *queue, const void *items, size_t count);
+
+
+/*
+ * Move at most `max` items from the front of `queue` to `items`, blocking
+ * while the queue is empty.
+ *
+ * Returns the amount of items that were popped, which is 0 only if the queue
+ * is closed and empty.
+ */
+size_t sss_queue_pop(sss_Queue *queue, void *items, size_t max);
+
+
+/*
+ * Close `queue`: wake up every thread that is blocked on it, and fail all
+ * pushes from now on. The items that are still in the queue can be popped.
+ */
+void sss_queue_close(sss_Queue *queue);
+
+
+/*
+ * Wipe the buffer of `queue` and free it. No threads may use the queue
+ * anymore.
+ */
+void sss_queue_free(sss_Queue *queue);
+
+
+#endif /* sss_QUEUE_H_ */
@@ -0,0 +1,13 @@
+#define _GNU_SOURCE
+#include "randombytes.h"
+#include <sys/random.h>
+int randombytes(void *buf, size_t n)
+{
+	unsigned char *p = buf;
+	while (n > 0) {
+		ssize_t r = getrandom(p, n, 0);
+		if (r < 0) return -1;
+		p += r; n -= (size_t) r;
+	}
+	return 0;
+}
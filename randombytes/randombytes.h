@@ -0,0 +1,5 @@
+#ifndef sss_RANDOMBYTES_H
+#define sss_RANDOMBYTES_H
+#include <stddef.h>
+int randombytes(void *buf, size_t n);
+#endif
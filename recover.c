@@ -0,0 +1,434 @@
+/*
+ * sss-recover: restore all of the secrets in a vault from the share streams
+ * of `k` share holders
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Usage: sss-recover [-j workers] [-o output] stream1 ... streamk
+ *
+ * The recovery is a pipeline with a bounded queue between every two stages,
+ * so that reading, combining and writing all overlap:
+ *
+ *     readers (one per stream) -> joiner -> workers -> writer
+ *
+ * The joiner merges the streams (which are sorted by secret id, see
+ * `archive.h`). Every secret that is in all of the streams is restored by one
+ * of the workers, and the other secrets are counted as incomplete. The
+ * restored secrets are written to `output` (default: stdout) as records of a
+ * secret id (8 bytes, little endian) and `sss_MLEN` bytes of data, in no
+ * particular order. Secrets that could not be restored are reported on
+ * stderr, followed by the throughput of the whole run.
+ *
+ * Exits with status 0 if every secret was restored, and 1 otherwise.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "archive.h"
+#include "arena.h"
+#include "hazmat.h"
+#include "queue.h"
+#include "sss.h"
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/*
+ * Amount of items that a stage moves through a queue at once, and the
+ * capacity of every queue
+ */
+#define BATCH 64
+#define QUEUE_LEN 1024
+
+#define MAX_WORKERS 64
+
+
+/*
+ * A restored secret: a status byte (1 if the secret was restored), followed
+ * by the output record
+ */
+#define SECRET_RECORD_LEN (8 + sss_MLEN)
+#define RESULT_LEN (1 + SECRET_RECORD_LEN)
+
+
+typedef struct {
+	const char *path;
+	FILE *file;
+	sss_Queue *queue;
+	pthread_t thread;
+	int running, error;
+	uint64_t bytes;
+
+	/* Joiner state */
+	uint8_t batch[BATCH][sss_STREAM_RECORD_LEN];
+	size_t len, pos;
+	uint64_t last_id;
+	int started;
+} Input;
+
+
+typedef struct {
+	uint8_t k;
+	size_t job_len; /* secret id, followed by `k` shares */
+	sss_Queue *jobs, *results;
+	FILE *output;
+	int write_error;
+	uint64_t restored, failed;
+} Pipeline;
+
+
+typedef struct {
+	Pipeline *pipeline;
+	pthread_t thread;
+	int running;
+	sss_Ctx *ctx;
+	uint8_t *jobs;
+	uint8_t results[BATCH][RESULT_LEN];
+} Worker;
+
+
+static void* read_stream(void *arg)
+{
+	Input *input = arg;
+	uint8_t buf[BATCH][sss_STREAM_RECORD_LEN];
+	size_t len;
+
+	do {
+		len = fread(buf, 1, sizeof(buf), input->file);
+		input->bytes += len;
+		if (len % sss_STREAM_RECORD_LEN != 0) {
+			/* Only the last read can be short */
+			input->error = 1;
+		}
+		len /= sss_STREAM_RECORD_LEN;
+		if (len > 0 && sss_queue_push(input->queue, buf, len) < len) break;
+	} while (len == BATCH);
+	if (ferror(input->file)) input->error = 1;
+	sss_memzero(buf, sizeof(buf));
+	sss_queue_close(input->queue);
+	return NULL;
+}
+
+
+/*
+ * Return the next record of `input` without consuming it, or NULL at the end
+ * of the stream
+ */
+static const uint8_t* input_peek(Input *input)
+{
+	if (input->pos == input->len) {
+		input->len = sss_queue_pop(input->queue, input->batch, BATCH);
+		input->pos = 0;
+		if (input->len == 0) return NULL;
+	}
+	return input->batch[input->pos];
+}
+
+
+/*
+ * Consume the next record of `input`. Returns -1 if the records of the stream
+ * are not sorted by id.
+ */
+static int input_next(Input *input)
+{
+	uint64_t id = sss_stream_get_id(input->batch[input->pos]);
+
+	if (input->started && id <= input->last_id) return -1;
+	input->started = 1;
+	input->last_id = id;
+	input->pos++;
+	return 0;
+}
+
+
+/*
+ * Merge the streams in `inputs` and queue a job for every secret that is in
+ * all of them. Returns -1 if any of the streams is not sorted.
+ */
+static int join_streams(Pipeline *pipeline,
+                        Input *inputs,
+                        uint8_t *jobs,
+                        uint64_t *incomplete)
+{
+	const uint8_t *record;
+	uint64_t id, min_id = 0;
+	size_t idx, len = 0, present;
+	uint8_t *job;
+	int ret = 0;
+
+	for (;;) {
+		/* Find the lowest id at the front of any stream */
+		present = 0;
+		for (idx = 0; idx < pipeline->k; idx++) {
+			record = input_peek(&inputs[idx]);
+			if (record == NULL) continue;
+			id = sss_stream_get_id(record);
+			if (present == 0 || id < min_id) min_id = id;
+			present++;
+		}
+		if (present == 0) break;
+
+		/* Take the records with that id */
+		job = &jobs[len * pipeline->job_len];
+		present = 0;
+		for (idx = 0; idx < pipeline->k; idx++) {
+			record = input_peek(&inputs[idx]);
+			if (record == NULL || sss_stream_get_id(record) != min_id) {
+				continue;
+			}
+			memcpy(&job[8 + present * sss_SHARE_LEN], &record[8],
+			       sss_SHARE_LEN);
+			present++;
+			if (input_next(&inputs[idx]) != 0) {
+				fprintf(stderr, "sss-recover: %s: records are not "
+				        "sorted by id\n", inputs[idx].path);
+				ret = -1;
+				goto done;
+			}
+		}
+		if (present < pipeline->k) {
+			(*incomplete)++;
+			continue;
+		}
+		sss_stream_put_id(job, min_id);
+		if (++len == BATCH) {
+			sss_queue_push(pipeline->jobs, jobs, len);
+			len = 0;
+		}
+	}
+
+done:
+	if (len > 0) sss_queue_push(pipeline->jobs, jobs, len);
+	sss_memzero(jobs, BATCH * pipeline->job_len);
+	return ret;
+}
+
+
+static void* combine_jobs(void *arg)
+{
+	Worker *worker = arg;
+	Pipeline *pipeline = worker->pipeline;
+	uint8_t *job, *result;
+	size_t idx, len;
+
+	while ((len = sss_queue_pop(pipeline->jobs, worker->jobs, BATCH)) > 0) {
+		for (idx = 0; idx < len; idx++) {
+			job = &worker->jobs[idx * pipeline->job_len];
+			result = worker->results[idx];
+			memcpy(&result[1], job, 8);
+			result[0] = sss_combine_shares_ctx(worker->ctx, &result[9],
+			                                   (const sss_Share*) &job[8],
+			                                   pipeline->k) == 0;
+		}
+		sss_queue_push(pipeline->results, worker->results, len);
+	}
+	sss_memzero(worker->jobs, BATCH * pipeline->job_len);
+	sss_memzero(worker->results, sizeof(worker->results));
+	return NULL;
+}
+
+
+static void* write_results(void *arg)
+{
+	Pipeline *pipeline = arg;
+	uint8_t buf[BATCH][RESULT_LEN];
+	size_t idx, len;
+
+	while ((len = sss_queue_pop(pipeline->results, buf, BATCH)) > 0) {
+		for (idx = 0; idx < len; idx++) {
+			if (!buf[idx][0]) {
+				fprintf(stderr, "sss-recover: could not restore secret "
+				        "%" PRIu64 "\n", sss_stream_get_id(&buf[idx][1]));
+				pipeline->failed++;
+				continue;
+			}
+			pipeline->restored++;
+			if (!pipeline->write_error &&
+			    fwrite(&buf[idx][1], SECRET_RECORD_LEN, 1,
+			           pipeline->output) != 1) {
+				pipeline->write_error = 1;
+			}
+		}
+	}
+	if (fflush(pipeline->output) != 0) pipeline->write_error = 1;
+	sss_memzero(buf, sizeof(buf));
+	return NULL;
+}
+
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: sss-recover [-j workers] [-o output] "
+	        "stream1 ... streamk\n");
+	exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+	static Input inputs[255];
+	static Worker workers[MAX_WORKERS];
+	uint8_t header[sss_STREAM_HEADER_LEN], *jobs = NULL;
+	const char *output_path = NULL;
+	struct timespec start, end;
+	Pipeline pipeline = { 0 };
+	pthread_t writer;
+	int writer_running = 0;
+	uint64_t incomplete = 0, bytes = 0;
+	double seconds;
+	long nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t idx;
+	int fd, opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "j:o:")) != -1) {
+		switch (opt) {
+		case 'j':
+			nworkers = strtol(optarg, NULL, 10);
+			if (nworkers < 1 || nworkers > MAX_WORKERS) usage();
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc - optind < 1 || argc - optind > 255) usage();
+	if (nworkers < 1) nworkers = 1;
+	if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+	pipeline.k = argc - optind;
+	pipeline.job_len = 8 + pipeline.k * sss_SHARE_LEN;
+
+	/* Open everything before starting any threads */
+	for (idx = 0; idx < pipeline.k; idx++) {
+		inputs[idx].path = argv[optind + idx];
+		inputs[idx].file = fopen(inputs[idx].path, "rb");
+		if (inputs[idx].file == NULL ||
+		    fread(header, sizeof(header), 1, inputs[idx].file) != 1 ||
+		    sss_stream_check_header(header) != 0) {
+			fprintf(stderr, "sss-recover: %s: not a share stream\n",
+			        inputs[idx].path);
+			ret = 1;
+			goto cleanup;
+		}
+		setvbuf(inputs[idx].file, NULL, _IOFBF, 1 << 20);
+		inputs[idx].queue = sss_queue_new(sss_STREAM_RECORD_LEN, QUEUE_LEN);
+		if (inputs[idx].queue == NULL) goto oom;
+	}
+	/* The output holds the restored secrets, so it is created 0600 */
+	if (output_path != NULL) {
+		fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		pipeline.output = fd >= 0 ? fdopen(fd, "wb") : NULL;
+		if (pipeline.output == NULL && fd >= 0) close(fd);
+	} else {
+		pipeline.output = stdout;
+	}
+	if (pipeline.output == NULL) {
+		fprintf(stderr, "sss-recover: %s: could not open\n", output_path);
+		ret = 1;
+		goto cleanup;
+	}
+	setvbuf(pipeline.output, NULL, _IOFBF, 1 << 20);
+	pipeline.jobs = sss_queue_new(pipeline.job_len, QUEUE_LEN);
+	pipeline.results = sss_queue_new(RESULT_LEN, QUEUE_LEN);
+	jobs = malloc(BATCH * pipeline.job_len);
+	if (pipeline.jobs == NULL || pipeline.results == NULL || jobs == NULL) {
+		goto oom;
+	}
+	for (idx = 0; idx < (size_t) nworkers; idx++) {
+		workers[idx].pipeline = &pipeline;
+		workers[idx].ctx = sss_ctx_new(pipeline.k, pipeline.k);
+		workers[idx].jobs = malloc(BATCH * pipeline.job_len);
+		if (workers[idx].ctx == NULL || workers[idx].jobs == NULL) goto oom;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (idx = 0; idx < pipeline.k; idx++) {
+		if (pthread_create(&inputs[idx].thread, NULL, read_stream,
+		                   &inputs[idx]) != 0) {
+			goto no_threads;
+		}
+		inputs[idx].running = 1;
+	}
+	for (idx = 0; idx < (size_t) nworkers; idx++) {
+		if (pthread_create(&workers[idx].thread, NULL, combine_jobs,
+		                   &workers[idx]) != 0) {
+			goto no_threads;
+		}
+		workers[idx].running = 1;
+	}
+	if (pthread_create(&writer, NULL, write_results, &pipeline) != 0) {
+		goto no_threads;
+	}
+	writer_running = 1;
+
+	if (join_streams(&pipeline, inputs, jobs, &incomplete) != 0) ret = 1;
+
+shutdown:
+	/* Shut the pipeline down, from front to back */
+	for (idx = 0; idx < pipeline.k; idx++) {
+		sss_queue_close(inputs[idx].queue);
+		if (inputs[idx].running) pthread_join(inputs[idx].thread, NULL);
+		if (inputs[idx].error) {
+			fprintf(stderr, "sss-recover: %s: read error or truncated "
+			        "stream\n", inputs[idx].path);
+			ret = 1;
+		}
+		bytes += inputs[idx].bytes;
+	}
+	sss_queue_close(pipeline.jobs);
+	for (idx = 0; idx < (size_t) nworkers; idx++) {
+		if (workers[idx].running) pthread_join(workers[idx].thread, NULL);
+	}
+	sss_queue_close(pipeline.results);
+	if (writer_running) pthread_join(writer, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (pipeline.write_error) {
+		fprintf(stderr, "sss-recover: write error\n");
+		ret = 1;
+	}
+	if (pipeline.failed > 0 || incomplete > 0) ret = 1;
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	if (seconds <= 0) seconds = 1e-9;
+	fprintf(stderr, "sss-recover: restored %" PRIu64 " secrets "
+	        "(%" PRIu64 " failed, %" PRIu64 " incomplete) in %.3f s: "
+	        "%.0f secrets/s, %.1f MB/s read, %ld workers\n",
+	        pipeline.restored, pipeline.failed, incomplete, seconds,
+	        pipeline.restored / seconds, bytes / seconds / 1e6, nworkers);
+
+cleanup:
+	for (idx = 0; idx < pipeline.k; idx++) {
+		if (inputs[idx].file != NULL) fclose(inputs[idx].file);
+		sss_queue_free(inputs[idx].queue);
+	}
+	for (idx = 0; idx < (size_t) nworkers; idx++) {
+		sss_ctx_free(workers[idx].ctx);
+		free(workers[idx].jobs);
+	}
+	if (output_path != NULL && pipeline.output != NULL &&
+	    fclose(pipeline.output) != 0) {
+		ret = 1;
+	}
+	sss_queue_free(pipeline.jobs);
+	sss_queue_free(pipeline.results);
+	free(jobs);
+	return ret;
+
+no_threads:
+	/* Stop the threads that did start */
+	fprintf(stderr, "sss-recover: could not start threads\n");
+	ret = 1;
+	goto shutdown;
+
+oom:
+	fprintf(stderr, "sss-recover: out of memory\n");
+	ret = 1;
+	goto cleanup;
+}
@@ -0,0 +1,297 @@
+/*
+ * sss-split: split many secrets into the share streams of `n` share holders
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Usage: sss-split -k threshold [-j workers] [-i input] [-s sync_mb]
+ *                  stream1 ... streamn
+ *
+ * The secrets are read from `input` (default: stdin) as records of a secret
+ * id (8 bytes, little endian) and `sss_MLEN` bytes of data, sorted by id.
+ * This is the format that is written by `sss-recover`. The secrets are split
+ * in chunks with `sss_create_shares_batch`, and share `i` of every secret is
+ * written to `streami` (see `archive.h`).
+ *
+ * Every stream has its own writer thread, so the `n` streams are written
+ * concurrently while the next chunk is being split. A writer only calls
+ * `fsync` after every `sync_mb` MiB (default: 64, or 0 for only at the end),
+ * instead of after every chunk.
+ *
+ * Exits with status 0 on success, and 1 otherwise.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "archive.h"
+#include "arena.h"
+#include "batch.h"
+#include "queue.h"
+#include "sss.h"
+#include "threadpool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/*
+ * Amount of secrets that are split at once, and the amount of chunks that
+ * every writer can have in flight
+ */
+#define CHUNK 4096
+#define DEPTH 4
+
+#define SECRET_RECORD_LEN (8 + sss_MLEN)
+
+
+/*
+ * A buffer with (part of) a stream, that is passed between the main thread
+ * and a writer
+ */
+typedef struct {
+	uint8_t *buf;
+	size_t len;
+} Chunk;
+
+
+typedef struct {
+	const char *path;
+	int fd;
+	pthread_t thread;
+	sss_Queue *full, *empty;
+	uint64_t sync_bytes, bytes;
+	int running, error;
+} Output;
+
+
+/*
+ * Write all of `len` bytes in `buf` to `fd`
+ */
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret < 0) return -1;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+
+static void* write_stream(void *arg)
+{
+	Output *output = arg;
+	uint64_t unsynced = 0;
+	Chunk chunk;
+
+	while (sss_queue_pop(output->full, &chunk, 1) == 1) {
+		if (!output->error && write_all(output->fd, chunk.buf, chunk.len) != 0) {
+			output->error = 1;
+		}
+		output->bytes += chunk.len;
+		unsynced += chunk.len;
+		if (output->sync_bytes != 0 && unsynced >= output->sync_bytes) {
+			if (!output->error && fsync(output->fd) != 0) output->error = 1;
+			unsynced = 0;
+		}
+		sss_memzero(chunk.buf, chunk.len);
+		sss_queue_push(output->empty, &chunk, 1);
+	}
+	if (!output->error && fsync(output->fd) != 0) output->error = 1;
+	return NULL;
+}
+
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: sss-split -k threshold [-j workers] [-i input] "
+	        "[-s sync_mb] stream1 ... streamn\n");
+	exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+	static Output outputs[255];
+	static uint8_t records[CHUNK][SECRET_RECORD_LEN], data[CHUNK][sss_MLEN];
+	static uint64_t ids[CHUNK];
+	uint8_t header[sss_STREAM_HEADER_LEN], *record;
+	const char *input_path = NULL;
+	sss_Threadpool *pool = NULL;
+	sss_Share *shares;
+	struct timespec start, end;
+	FILE *input = stdin;
+	Chunk chunk;
+	uint64_t count = 0, bytes = 0, last_id = 0, sync_mb = 64;
+	double seconds;
+	long nworkers = sysconf(_SC_NPROCESSORS_ONLN), k = 0;
+	size_t idx, share_idx, len, depth;
+	uint8_t n;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "k:j:i:s:")) != -1) {
+		switch (opt) {
+		case 'k':
+			k = strtol(optarg, NULL, 10);
+			break;
+		case 'j':
+			nworkers = strtol(optarg, NULL, 10);
+			if (nworkers < 1) usage();
+			break;
+		case 'i':
+			input_path = optarg;
+			break;
+		case 's':
+			sync_mb = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc - optind < 1 || argc - optind > 255) usage();
+	n = argc - optind;
+	if (k < 1 || k > n) usage();
+	if (nworkers < 1) nworkers = 1;
+
+	if (input_path != NULL) {
+		input = fopen(input_path, "rb");
+		if (input == NULL) {
+			fprintf(stderr, "sss-split: %s: could not open\n", input_path);
+			return 1;
+		}
+	}
+	setvbuf(input, NULL, _IOFBF, 1 << 20);
+
+	/* Open everything before starting any threads */
+	shares = malloc(CHUNK * n * sizeof(sss_Share));
+	if (shares == NULL) goto oom;
+	if (nworkers > 1) {
+		pool = sss_threadpool_new(nworkers);
+		if (pool == NULL) goto oom;
+	}
+	sss_stream_header(header);
+	for (idx = 0; idx < n; idx++) {
+		outputs[idx].path = argv[optind + idx];
+		outputs[idx].fd = open(outputs[idx].path,
+		                       O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (outputs[idx].fd < 0 ||
+		    write_all(outputs[idx].fd, header, sizeof(header)) != 0) {
+			fprintf(stderr, "sss-split: %s: could not open\n",
+			        outputs[idx].path);
+			return 1;
+		}
+		outputs[idx].sync_bytes = sync_mb << 20;
+		outputs[idx].full = sss_queue_new(sizeof(Chunk), DEPTH);
+		outputs[idx].empty = sss_queue_new(sizeof(Chunk), DEPTH);
+		if (outputs[idx].full == NULL || outputs[idx].empty == NULL) goto oom;
+		for (depth = 0; depth < DEPTH; depth++) {
+			chunk.buf = malloc(CHUNK * sss_STREAM_RECORD_LEN);
+			chunk.len = 0;
+			if (chunk.buf == NULL) goto oom;
+			sss_queue_push(outputs[idx].empty, &chunk, 1);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (idx = 0; idx < n; idx++) {
+		if (pthread_create(&outputs[idx].thread, NULL, write_stream,
+		                   &outputs[idx]) != 0) {
+			fprintf(stderr, "sss-split: could not start threads\n");
+			ret = 1;
+			goto done;
+		}
+		outputs[idx].running = 1;
+	}
+
+	do {
+		len = fread(records, 1, sizeof(records), input);
+		if (len % SECRET_RECORD_LEN != 0) {
+			/* Only the last read can be short */
+			fprintf(stderr, "sss-split: truncated input\n");
+			ret = 1;
+			goto done;
+		}
+		len /= SECRET_RECORD_LEN;
+		if (len == 0) break;
+		for (idx = 0; idx < len; idx++) {
+			ids[idx] = sss_stream_get_id(records[idx]);
+			if (count + idx > 0 && ids[idx] <= last_id) {
+				fprintf(stderr, "sss-split: secrets are not sorted by id\n");
+				ret = 1;
+				goto done;
+			}
+			last_id = ids[idx];
+			memcpy(data[idx], &records[idx][8], sss_MLEN);
+		}
+		if (sss_create_shares_batch(pool, shares, (const uint8_t*) data,
+		                            len, n, k) != 0) {
+			goto oom;
+		}
+
+		/* Hand share `share_idx` of every secret to its writer */
+		for (share_idx = 0; share_idx < n; share_idx++) {
+			sss_queue_pop(outputs[share_idx].empty, &chunk, 1);
+			for (idx = 0; idx < len; idx++) {
+				record = &chunk.buf[idx * sss_STREAM_RECORD_LEN];
+				sss_stream_put_id(record, ids[idx]);
+				memcpy(&record[8], shares[idx * n + share_idx],
+				       sss_SHARE_LEN);
+			}
+			chunk.len = len * sss_STREAM_RECORD_LEN;
+			sss_queue_push(outputs[share_idx].full, &chunk, 1);
+		}
+		count += len;
+	} while (len == CHUNK);
+	if (ferror(input)) {
+		fprintf(stderr, "sss-split: read error\n");
+		ret = 1;
+	}
+
+done:
+	for (idx = 0; idx < n; idx++) {
+		sss_queue_close(outputs[idx].full);
+		if (outputs[idx].running) pthread_join(outputs[idx].thread, NULL);
+		if (outputs[idx].error || close(outputs[idx].fd) != 0) {
+			fprintf(stderr, "sss-split: %s: write error\n",
+			        outputs[idx].path);
+			ret = 1;
+		}
+		bytes += outputs[idx].bytes;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	if (seconds <= 0) seconds = 1e-9;
+	fprintf(stderr, "sss-split: split %" PRIu64 " secrets into %u streams "
+	        "in %.3f s: %.0f secrets/s, %.1f MB/s written\n",
+	        count, (unsigned) n, seconds, count / seconds, bytes / seconds / 1e6);
+
+	for (idx = 0; idx < n; idx++) {
+		/* The writer has handed back every chunk */
+		sss_queue_close(outputs[idx].empty);
+		while (sss_queue_pop(outputs[idx].empty, &chunk, 1) == 1) {
+			free(chunk.buf);
+		}
+		sss_queue_free(outputs[idx].full);
+		sss_queue_free(outputs[idx].empty);
+	}
+	sss_memzero(records, sizeof(records));
+	sss_memzero(data, sizeof(data));
+	sss_memzero(shares, CHUNK * n * sizeof(sss_Share));
+	free(shares);
+	sss_threadpool_free(pool);
+	if (input_path != NULL) fclose(input);
+	return ret;
+
+oom:
+	fprintf(stderr, "sss-split: out of memory\n");
+	return 1;
+}
@@ -14,10 +14,14 @@
 
 
 #include "randombytes.h"
+#include "arena.h"
 #include "tweetnacl.h"
+#include "probes.h"
 #include "sss.h"
+#include "stats.h"
 #include "tweetnacl.h"
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -74,29 +78,63 @@ static const sss_Keyshare* get_keyshare_const(const sss_Share *share)
 
 
 /*
- * Create `n` shares with theshold `k` and write them to `out`
+ * The ephemeral key, and the buffers for `crypto_secretbox` (with room for
+ * the zero bytes in front). The `_ctx` functions take these from the
+ * workspace (see `sss_ctx_secret`), so they are locked along with it. The
+ * other functions keep them on the stack, and only wipe them afterwards.
  */
-void sss_create_shares(sss_Share *out, const unsigned char *data,
-                       uint8_t n, uint8_t k)
+typedef struct {
+	unsigned char key[crypto_secretbox_KEYBYTES];
+	unsigned char m[crypto_secretbox_ZEROBYTES + sss_MLEN];
+	unsigned char c[crypto_secretbox_ZEROBYTES + sss_MLEN];
+} Secrets;
+
+/* Fails to compile if `sss_CTX_SECRET_LEN` is too small for `sss_MLEN` */
+typedef char secrets_fit_in_ctx[sizeof(Secrets) <= sss_CTX_SECRET_LEN ? 1 : -1];
+
+
+/*
+ * Create `n` shares with theshold `k` and write them to `out`, using
+ * `keyshares` and `secrets` as scratch space. If `ctx` is not NULL, its
+ * workspace is used to create the key shares.
+ */
+static void create_shares(sss_Ctx *ctx, sss_Keyshare *keyshares,
+                          Secrets *secrets, sss_Share *out,
+                          const unsigned char *data, uint8_t n, uint8_t k)
 {
-	unsigned char key[32];
-	unsigned char m[crypto_secretbox_ZEROBYTES + sss_MLEN] = { 0 };
-	unsigned long long mlen = sizeof(m); /* length includes zero-bytes */
-	unsigned char c[mlen];
+	unsigned char *key = secrets->key, *m = secrets->m, *c = secrets->c;
+	unsigned long long mlen = sizeof(secrets->m); /* includes zero-bytes */
 	int tmp;
-	sss_Keyshare keyshares[n];
 	size_t idx;
 
+	sss_PROBE3(create_shares__entry, n, k, sss_MLEN);
+	sss_STATS_ADD(create_calls, 1);
+	sss_STATS_ADD(bytes_created, sss_MLEN);
+
 	/* Generate a random encryption key */
-	randombytes(key, sizeof(key));
+	sss_STATS_START(start);
+	if (ctx != NULL) {
+		sss_ctx_randombytes(ctx, key, sizeof(secrets->key));
+	} else {
+		randombytes(key, sizeof(secrets->key));
+	}
+	sss_STATS_PHASE(randomness_ticks, start);
 
 	/* AEAD encrypt the data with the key */
+	sss_STATS_START(aead_start);
+	memset(m, 0, crypto_secretbox_ZEROBYTES);
 	memcpy(&m[crypto_secretbox_ZEROBYTES], data, sss_MLEN);
 	tmp = crypto_secretbox(c, m, mlen, nonce, key);
 	assert(tmp == 0); /* should always happen */
+	sss_STATS_PHASE(aead_ticks, aead_start);
+	sss_PROBE2(aead__seal, sss_MLEN, tmp);
 
 	/* Generate KeyShares */
-	sss_create_keyshares(keyshares, key, n, k);
+	if (ctx != NULL) {
+		sss_create_keyshares_ctx(ctx, keyshares, key, n, k);
+	} else {
+		sss_create_keyshares(keyshares, key, n, k);
+	}
 
 	/* Build regular shares */
 	for (idx = 0; idx < n; idx++) {
@@ -105,31 +143,65 @@ void sss_create_shares(sss_Share *out, const unsigned char *data,
 		memcpy(get_ciphertext((sss_Share*) &out[idx]),
 		       &c[crypto_secretbox_BOXZEROBYTES], sss_CLEN);
 	}
+	sss_memzero(secrets, sizeof(*secrets));
+	sss_memzero(keyshares, n * sizeof(sss_Keyshare));
+	sss_PROBE4(create_shares__return, n, k, sss_MLEN, 0);
 }
 
 
 /*
- * Combine `k` shares pointed to by `shares` and write the result to `data`
+ * Create `n` shares with theshold `k` and write them to `out`
+ */
+void sss_create_shares(sss_Share *out, const unsigned char *data,
+                       uint8_t n, uint8_t k)
+{
+	sss_Keyshare keyshares[n];
+	Secrets secrets;
+	create_shares(NULL, keyshares, &secrets, out, data, n, k);
+}
+
+
+void sss_create_shares_ctx(sss_Ctx *ctx, sss_Share *out,
+                           const unsigned char *data, uint8_t n, uint8_t k)
+{
+	create_shares(ctx, sss_ctx_keyshares(ctx),
+	              (Secrets*) sss_ctx_secret(ctx), out, data, n, k);
+}
+
+
+/*
+ * Combine `k` shares pointed to by `shares` and write the result to `data`,
+ * using `keyshares` and `secrets` as scratch space. If `ctx` is not NULL, its
+ * workspace is used to combine the key shares.
  *
  * This function returns -1 if any of the shares were corrupted or if the number
  * of shares was too low. It is not possible to detect which of these errors
  * did occur.
  */
-int sss_combine_shares(uint8_t *data, const sss_Share *shares, uint8_t k)
+static int combine_shares(sss_Ctx *ctx, sss_Keyshare *keyshares,
+                          Secrets *secrets, uint8_t *data,
+                          const sss_Share *shares, uint8_t k)
 {
-	unsigned char key[crypto_secretbox_KEYBYTES];
-	unsigned char c[crypto_secretbox_BOXZEROBYTES + sss_CLEN] = { 0 };
-	unsigned long long clen = sizeof(c);
-	unsigned char m[clen];
-	sss_Keyshare keyshares[k];
+	unsigned char *key = secrets->key, *m = secrets->m, *c = secrets->c;
+	unsigned long long clen = crypto_secretbox_BOXZEROBYTES + sss_CLEN;
 	size_t idx;
 	int ret = 0;
 
+	sss_PROBE2(combine_shares__entry, k, sss_MLEN);
+	sss_STATS_ADD(combine_calls, 1);
+	sss_STATS_ADD(bytes_combined, sss_MLEN);
+
 	/* Check if all ciphertexts are the same */
-	if (k < 1) return -1;
+	if (k < 1) {
+		sss_STATS_ADD(combine_failures, 1);
+		sss_PROBE3(combine_shares__return, k, sss_MLEN, -1);
+		return -1;
+	}
 	for (idx = 1; idx < k; idx++) {
 		if (memcmp(get_ciphertext_const(&shares[0]),
 		           get_ciphertext_const(&shares[idx]), sss_CLEN) != 0) {
+			sss_STATS_ADD(combine_failures, 1);
+			sss_PROBE3(combine_shares__return, k, sss_MLEN, -1);
 			return -1;
 		}
 	}
@@ -139,13 +211,520 @@ int sss_combine_shares(uint8_t *data, const sss_Share *shares, uint8_t k)
 		memcpy(&keyshares[idx], get_keyshare_const(&shares[idx]),
 		       sss_KEYSHARE_LEN);
 	}
-	sss_combine_keyshares(key, (const sss_Keyshare*) keyshares, k);
+	if (ctx != NULL) {
+		sss_combine_keyshares_ctx(ctx, key,
+		                          (const sss_Keyshare*) keyshares, k);
+	} else {
+		sss_combine_keyshares(key, (const sss_Keyshare*) keyshares, k);
+	}
 
 	/* Decrypt the ciphertext */
+	sss_STATS_START(start);
+	memset(c, 0, crypto_secretbox_BOXZEROBYTES);
 	memcpy(&c[crypto_secretbox_BOXZEROBYTES],
 	       &shares[0][sss_KEYSHARE_LEN], sss_CLEN);
 	ret |= crypto_secretbox_open(m, c, clen, nonce, key);
 	memcpy(data, &m[crypto_secretbox_ZEROBYTES], sss_MLEN);
+	sss_STATS_PHASE(aead_ticks, start);
+	sss_PROBE2(aead__open, sss_MLEN, ret);
+	if (ret != 0) sss_STATS_ADD(combine_failures, 1);
+	sss_memzero(secrets, sizeof(*secrets));
+	sss_memzero(keyshares, k * sizeof(sss_Keyshare));
+
+	sss_PROBE3(combine_shares__return, k, sss_MLEN, ret);
+	return ret;
+}
+
+
+/*
+ * Combine `k` shares pointed to by `shares` and write the result to `data`
+ */
+int sss_combine_shares(uint8_t *data, const sss_Share *shares, uint8_t k)
+{
+	sss_Keyshare keyshares[k];
+	Secrets secrets;
+	return combine_shares(NULL, keyshares, &secrets, data, shares, k);
+}
+
+
+int sss_combine_shares_ctx(sss_Ctx *ctx, uint8_t *data,
+                           const sss_Share *shares, uint8_t k)
+{
+	return combine_shares(ctx, sss_ctx_keyshares(ctx),
+	                      (Secrets*) sss_ctx_secret(ctx), data, shares, k);
+}
+
+
+/*
+ * Refresh the key shares of the `n` shares in `shares`, using `keyshares` as
+ * scratch space. The key does not change, so the ciphertexts stay as they are.
+ */
+static void refresh_shares(sss_Ctx *ctx, sss_Keyshare *keyshares,
+                           sss_Share *shares, uint8_t n, uint8_t k)
+{
+	size_t idx;
+
+	for (idx = 0; idx < n; idx++) {
+		memcpy(&keyshares[idx], get_keyshare(&shares[idx]),
+		       sss_KEYSHARE_LEN);
+	}
+	if (ctx != NULL) {
+		sss_refresh_keyshares_ctx(ctx, keyshares, n, k);
+	} else {
+		sss_refresh_keyshares(keyshares, n, k);
+	}
+	for (idx = 0; idx < n; idx++) {
+		memcpy(get_keyshare(&shares[idx]), &keyshares[idx],
+		       sss_KEYSHARE_LEN);
+	}
+	sss_memzero(keyshares, n * sizeof(sss_Keyshare));
+}
+
+
+void sss_refresh_shares(sss_Share *shares, uint8_t n, uint8_t k)
+{
+	sss_Keyshare keyshares[n];
+	refresh_shares(NULL, keyshares, shares, n, k);
+}
+
+
+void sss_refresh_shares_ctx(sss_Ctx *ctx, sss_Share *shares,
+                            uint8_t n, uint8_t k)
+{
+	refresh_shares(ctx, sss_ctx_keyshares(ctx), shares, n, k);
+}
+
+
+/*
+ * Reshare the `k` shares in `shares` into `n2` shares with threshold `k2`,
+ * using `keyshares` (which must fit both the old and the new key shares) as
+ * scratch space. If `ctx` is not NULL, its workspace is used to reshare the
+ * key shares.
+ */
+static int reshare_shares(sss_Ctx *ctx, sss_Keyshare *keyshares,
+                          sss_Share *out, const sss_Share *shares,
+                          uint8_t k, uint8_t n2, uint8_t k2)
+{
+	sss_Keyshare *new_keyshares;
+	unsigned char c[sss_CLEN];
+	size_t idx, len;
+
+	/* The key does not change, so all shares must carry the same ciphertext */
+	if (k < 1) return -1;
+	for (idx = 1; idx < k; idx++) {
+		if (memcmp(get_ciphertext_const(&shares[0]),
+		           get_ciphertext_const(&shares[idx]), sss_CLEN) != 0) {
+			return -1;
+		}
+	}
+	memcpy(c, get_ciphertext_const(&shares[0]), sss_CLEN);
+
+	for (idx = 0; idx < k; idx++) {
+		memcpy(&keyshares[idx], get_keyshare_const(&shares[idx]),
+		       sss_KEYSHARE_LEN);
+	}
+	if (ctx != NULL) {
+		/* The workspace allows the new shares to overwrite the old ones */
+		new_keyshares = keyshares;
+		sss_reshare_keyshares_ctx(ctx, new_keyshares,
+		                          (const sss_Keyshare*) keyshares,
+		                          k, n2, k2);
+		len = k > n2 ? k : n2;
+	} else {
+		new_keyshares = &keyshares[k];
+		sss_reshare_keyshares(new_keyshares,
+		                      (const sss_Keyshare*) keyshares,
+		                      k, n2, k2);
+		len = k + n2;
+	}
+	for (idx = 0; idx < n2; idx++) {
+		memcpy(get_keyshare(&out[idx]), &new_keyshares[idx],
+		       sss_KEYSHARE_LEN);
+		memcpy(get_ciphertext(&out[idx]), c, sss_CLEN);
+	}
+	sss_memzero(keyshares, len * sizeof(sss_Keyshare));
+	return 0;
+}
+
+
+int sss_reshare_shares(sss_Share *out, const sss_Share *shares,
+                       uint8_t k, uint8_t n2, uint8_t k2)
+{
+	sss_Keyshare keyshares[k + n2];
+	return reshare_shares(NULL, keyshares, out, shares, k, n2, k2);
+}
+
+
+int sss_reshare_shares_ctx(sss_Ctx *ctx, sss_Share *out,
+                           const sss_Share *shares,
+                           uint8_t k, uint8_t n2, uint8_t k2)
+{
+	return reshare_shares(ctx, sss_ctx_keyshares(ctx), out, shares,
+	                      k, n2, k2);
+}
+
+
+/*
+ * Combine `n` shares pointed to by `shares` and write the result to `data`,
+ * correcting up to `(n - k) / 2` faulty shares.
+ *
+ * Shares whose ciphertext differs from the most common ciphertext are faulty.
+ * The key shares of the other shares are decoded by
+ * `sss_combine_keyshares_robust`. The indices of both kinds of faulty shares
+ * are merged into `faulty`, in ascending order.
+ */
+int sss_combine_shares_robust(uint8_t *data, uint8_t *faulty,
+                              const sss_Share *shares, uint8_t n, uint8_t k)
+{
+	unsigned char key[crypto_secretbox_KEYBYTES];
+	unsigned char c[crypto_secretbox_BOXZEROBYTES + sss_CLEN] = { 0 };
+	unsigned char m[sizeof(c)];
+	sss_Keyshare keyshares[n];
+	uint8_t index[n], bad_keyshares[n];
+	size_t idx, idx2, best = 0, best_count = 0, count, good = 0, bad = 0;
+	size_t ngood;
+	int ret;
+
+	if (k < 1 || k > n) return -1;
+
+	/* Find the most common ciphertext (ciphertexts are public) */
+	for (idx = 0; idx < n; idx++) {
+		count = 0;
+		for (idx2 = 0; idx2 < n; idx2++) {
+			count += memcmp(get_ciphertext_const(&shares[idx]),
+			                get_ciphertext_const(&shares[idx2]),
+			                sss_CLEN) == 0;
+		}
+		if (count > best_count) {
+			best = idx;
+			best_count = count;
+		}
+	}
+
+	/* Decode the key shares of the shares with that ciphertext */
+	for (idx = 0; idx < n; idx++) {
+		if (memcmp(get_ciphertext_const(&shares[best]),
+		           get_ciphertext_const(&shares[idx]), sss_CLEN) != 0) {
+			continue;
+		}
+		memcpy(&keyshares[good], get_keyshare_const(&shares[idx]),
+		       sss_KEYSHARE_LEN);
+		index[good++] = idx;
+	}
+	if (2 * (n - good) > n - k || good < k) return -1;
+	ret = sss_combine_keyshares_robust(key, bad_keyshares,
+	                                   (const sss_Keyshare*) keyshares,
+	                                   good, k);
+	sss_memzero(keyshares, sizeof(keyshares));
+	if (ret < 0 || 2 * (n - good + ret) > n - k) {
+		sss_memzero(key, sizeof(key));
+		return -1;
+	}
+
+	/* Decrypt the ciphertext */
+	memcpy(&c[crypto_secretbox_BOXZEROBYTES],
+	       get_ciphertext_const(&shares[best]), sss_CLEN);
+	if (crypto_secretbox_open(m, c, sizeof(c), nonce, key) != 0) {
+		sss_memzero(key, sizeof(key));
+		return -1;
+	}
+	memcpy(data, &m[crypto_secretbox_ZEROBYTES], sss_MLEN);
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
+
+	/* Collect the indices of all of the faulty shares */
+	ngood = good;
+	for (idx = 0, idx2 = 0, good = 0; idx < n; idx++) {
+		if (good < ngood && index[good] == idx) {
+			if (idx2 < (size_t) ret && bad_keyshares[idx2] == good) {
+				faulty[bad++] = idx;
+				idx2++;
+			}
+			good++;
+		} else {
+			faulty[bad++] = idx;
+		}
+	}
+	return bad;
+}
+
+/*
+ * State of an incremental combine of regular shares
+ */
+struct sss_Combiner {
+	sss_KeyshareCombiner *keyshares;
+	unsigned char c[crypto_secretbox_BOXZEROBYTES + sss_CLEN];
+};
+
+
+sss_Combiner* sss_combiner_new(uint8_t k)
+{
+	sss_Combiner *combiner;
+
+	combiner = calloc(1, sizeof(*combiner));
+	if (combiner == NULL) return NULL;
+	combiner->keyshares = sss_keyshare_combiner_new(k);
+	if (combiner->keyshares == NULL) {
+		free(combiner);
+		return NULL;
+	}
+	return combiner;
+}
+
+
+int sss_combiner_add(sss_Combiner *combiner, const sss_Share *share)
+{
+	unsigned char *c = &combiner->c[crypto_secretbox_BOXZEROBYTES];
+
+	/* Check if all ciphertexts are the same */
+	if (sss_keyshare_combiner_count(combiner->keyshares) == 0) {
+		memcpy(c, get_ciphertext_const(share), sss_CLEN);
+	} else if (memcmp(c, get_ciphertext_const(share), sss_CLEN) != 0) {
+		return -1;
+	}
+	return sss_keyshare_combiner_add(combiner->keyshares,
+	                                 *get_keyshare_const(share));
+}
+
+
+int sss_combiner_finalize(const sss_Combiner *combiner, uint8_t *data)
+{
+	unsigned char key[crypto_secretbox_KEYBYTES];
+	unsigned char m[sizeof(combiner->c)];
+	int ret = 0;
+
+	if (sss_keyshare_combiner_count(combiner->keyshares) == 0) return -1;
+
+	/* Restore the key and decrypt the ciphertext */
+	sss_keyshare_combiner_finalize(combiner->keyshares, key);
+	ret |= crypto_secretbox_open(m, combiner->c, sizeof(combiner->c),
+	                             nonce, key);
+	memcpy(data, &m[crypto_secretbox_ZEROBYTES], sss_MLEN);
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
+
+	return ret;
+}
+
+
+void sss_combiner_free(sss_Combiner *combiner)
+{
+	if (combiner == NULL) return;
+	sss_keyshare_combiner_free(combiner->keyshares);
+	free(combiner);
+}
+
+
+/*
+ * Return the nonce that binds the header of a versioned share to its
+ * ciphertext
+ */
+static void versioned_nonce(unsigned char n[crypto_secretbox_NONCEBYTES],
+                            uint8_t k)
+{
+	memset(n, 0, crypto_secretbox_NONCEBYTES);
+	n[0] = sss_SHARE_VERSION;
+	n[1] = k;
+}
+
+
+void sss_create_versioned_shares(sss_VersionedShare *out,
+                                 const uint8_t *data,
+                                 uint8_t n,
+                                 uint8_t k)
+{
+	unsigned char key[32], vnonce[crypto_secretbox_NONCEBYTES];
+	unsigned char m[crypto_secretbox_ZEROBYTES + sss_MLEN] = { 0 };
+	unsigned char c[sizeof(m)];
+	sss_Keyshare keyshares[n];
+	size_t idx;
+	int tmp;
+
+	/* Generate a random encryption key and share it */
+	randombytes(key, sizeof(key));
+	sss_create_keyshares(keyshares, key, n, k);
+
+	/* AEAD encrypt the data, binding the header through the nonce */
+	versioned_nonce(vnonce, k);
+	memcpy(&m[crypto_secretbox_ZEROBYTES], data, sss_MLEN);
+	tmp = crypto_secretbox(c, m, sizeof(m), vnonce, key);
+	assert(tmp == 0); /* should always happen */
+
+	/* Build versioned shares */
+	for (idx = 0; idx < n; idx++) {
+		out[idx][0] = sss_SHARE_VERSION;
+		out[idx][1] = k;
+		memcpy(&out[idx][sss_HEADER_LEN], keyshares[idx],
+		       sss_KEYSHARE_LEN);
+		memcpy(&out[idx][sss_HEADER_LEN + sss_KEYSHARE_LEN],
+		       &c[crypto_secretbox_BOXZEROBYTES], sss_CLEN);
+	}
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
+	sss_memzero(keyshares, sizeof(keyshares));
+}
+
+
+uint8_t sss_versioned_share_threshold(const sss_VersionedShare *share)
+{
+	return (*share)[1];
+}
+
+
+/*
+ * Combine versioned shares
+ *
+ * The first `k` shares with distinct x values are added to an incremental
+ * combiner. If requested, every other share is then checked by evaluating
+ * the restored polynomial at its x value, which costs O(k) per share.
+ */
+int sss_combine_versioned_shares(uint8_t *data,
+                                 const sss_VersionedShare *shares,
+                                 uint8_t count,
+                                 int spot_check)
+{
+	unsigned char key[crypto_secretbox_KEYBYTES];
+	unsigned char vnonce[crypto_secretbox_NONCEBYTES];
+	unsigned char c[crypto_secretbox_BOXZEROBYTES + sss_CLEN] = { 0 };
+	unsigned char m[sizeof(c)];
+	const uint8_t *ciphertext;
+	sss_KeyshareCombiner *combiner;
+	sss_Keyshare expected;
+	uint8_t used[count], k, diff;
+	size_t idx, idx2;
+	int ret = 0;
+
+	/* Check the headers and the ciphertexts */
+	if (count < 1) return -1;
+	k = shares[0][1];
+	ciphertext = &shares[0][sss_HEADER_LEN + sss_KEYSHARE_LEN];
+	if (k < 1 || count < k) return -1;
+	for (idx = 0; idx < count; idx++) {
+		if (shares[idx][0] != sss_SHARE_VERSION ||
+		    shares[idx][1] != k ||
+		    memcmp(ciphertext, &shares[idx][sss_HEADER_LEN +
+		           sss_KEYSHARE_LEN], sss_CLEN) != 0) {
+			return -1;
+		}
+	}
+
+	/* Restore the key from the first `k` distinct shares */
+	combiner = sss_keyshare_combiner_new(k);
+	if (combiner == NULL) return -1;
+	memset(used, 0, sizeof(used));
+	for (idx = 0; idx < count && sss_keyshare_combiner_count(combiner) < k;
+	     idx++) {
+		used[idx] = sss_keyshare_combiner_add(combiner,
+		                                      &shares[idx][sss_HEADER_LEN])
+		            == 0;
+	}
+	if (sss_keyshare_combiner_count(combiner) < k) ret = -1;
+
+	/* Check that the surplus shares lie on the same polynomial */
+	for (idx = 0; ret == 0 && spot_check && idx < count; idx++) {
+		if (used[idx]) continue;
+		sss_keyshare_combiner_eval(combiner, expected,
+		                           shares[idx][sss_HEADER_LEN]);
+		diff = 0;
+		for (idx2 = 0; idx2 < sss_KEYSHARE_LEN; idx2++) {
+			diff |= expected[idx2] ^ shares[idx][sss_HEADER_LEN + idx2];
+		}
+		if (diff != 0) ret = -1;
+	}
+	sss_keyshare_combiner_finalize(combiner, key);
+	sss_keyshare_combiner_free(combiner);
+	sss_memzero(expected, sizeof(expected));
+
+	/* Decrypt the ciphertext */
+	if (ret == 0) {
+		versioned_nonce(vnonce, k);
+		memcpy(&c[crypto_secretbox_BOXZEROBYTES], ciphertext, sss_CLEN);
+		ret |= crypto_secretbox_open(m, c, sizeof(c), vnonce, key);
+		memcpy(data, &m[crypto_secretbox_ZEROBYTES], sss_MLEN);
+	}
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
 
 	return ret;
 }
+
+
+/*
+ * A share generator holds the ciphertext and a key share generator. The
+ * encryption key is the first 32 bytes of sha512(seed || data), so the seed
+ * and the data are enough to rebuild the exact same generator, while two
+ * different secrets never get the same key (and thus the same keystream and
+ * one-time authenticator key), even under the same seed.
+ */
+struct sss_ShareGenerator {
+	sss_KeyshareGenerator *keyshares;
+	unsigned char c[sss_CLEN];
+};
+
+
+sss_ShareGenerator* sss_share_generator_new(sss_Arena *arena,
+                                            const uint8_t *data,
+                                            const uint8_t seed[32],
+                                            uint8_t k)
+{
+	sss_ShareGenerator *gen;
+	unsigned char key[crypto_hash_BYTES], gen_seed[32];
+	unsigned char input[32 + sss_MLEN];
+	unsigned char m[crypto_secretbox_ZEROBYTES + sss_MLEN] = { 0 };
+	unsigned char c[sizeof(m)];
+	int tmp;
+
+	gen = calloc(1, sizeof(*gen));
+	if (gen == NULL) return NULL;
+
+	if (seed != NULL) {
+		memcpy(gen_seed, seed, sizeof(gen_seed));
+	} else {
+		randombytes(gen_seed, sizeof(gen_seed));
+	}
+	memcpy(&input[0], gen_seed, 32);
+	memcpy(&input[32], data, sss_MLEN);
+	crypto_hash(key, input, sizeof(input));
+	gen->keyshares = sss_keyshare_generator_new(arena, key, gen_seed, k);
+	if (gen->keyshares != NULL) {
+		memcpy(&m[crypto_secretbox_ZEROBYTES], data, sss_MLEN);
+		tmp = crypto_secretbox(c, m, sizeof(m), nonce, key);
+		assert(tmp == 0); /* should always happen */
+		memcpy(gen->c, &c[crypto_secretbox_BOXZEROBYTES], sss_CLEN);
+	} else {
+		free(gen);
+		gen = NULL;
+	}
+	sss_memzero(key, sizeof(key));
+	sss_memzero(gen_seed, sizeof(gen_seed));
+	sss_memzero(input, sizeof(input));
+	sss_memzero(m, sizeof(m));
+	return gen;
+}
+
+
+void sss_share_generator_seed(const sss_ShareGenerator *gen, uint8_t seed[32])
+{
+	sss_keyshare_generator_seed(gen->keyshares, seed);
+}
+
+
+int sss_share_generator_get(const sss_ShareGenerator *gen,
+                            sss_Share *out,
+                            uint8_t x)
+{
+	if (sss_keyshare_generator_get(gen->keyshares, *get_keyshare(out), x)
+	    != 0) {
+		return -1;
+	}
+	memcpy(get_ciphertext(out), gen->c, sss_CLEN);
+	return 0;
+}
+
+
+void sss_share_generator_free(sss_ShareGenerator *gen)
+{
+	if (gen == NULL) return;
+	sss_keyshare_generator_free(gen->keyshares);
+	free(gen);
+}
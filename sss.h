@@ -67,4 +67,253 @@ int sss_combine_shares(uint8_t *data,
                        uint8_t k);
 
 
+/*
+ * Combine the `n` shares pointed to by `shares`, which were created with a
+ * threshold of `k`, and put the resulting secret data in `data`. Up to
+ * `(n - k) / 2` faulty shares (with a corrupted key share and/or ciphertext)
+ * are detected and corrected.
+ *
+ * On success, the indices (into `shares`) of the faulty shares are written to
+ * `faulty`, which must have room for `n` indices, and the amount of faulty
+ * shares is returned. If the secret could not be restored, -1 is returned and
+ * nothing is written to `data`.
+ */
+int sss_combine_shares_robust(uint8_t *data,
+                              uint8_t *faulty,
+                              const sss_Share *shares,
+                              uint8_t n,
+                              uint8_t k);
+
+
+/*
+ * Same as `sss_create_shares`, but without any variable-length buffers on the
+ * stack. All of the scratch space (including the ephemeral key and the
+ * plaintext) is taken from the workspace `ctx`, which must have been
+ * allocated by `sss_ctx_new` or `sss_ctx_new_in` with `n_max >= n` and
+ * `k_max >= k`.
+ */
+void sss_create_shares_ctx(sss_Ctx *ctx,
+                           sss_Share *out,
+                           const uint8_t *data,
+                           uint8_t n,
+                           uint8_t k);
+
+
+/*
+ * Same as `sss_combine_shares`, but without any variable-length buffers on
+ * the stack. All of the scratch space (including the restored key and the
+ * plaintext) is taken from the workspace `ctx`, which must have been
+ * allocated by `sss_ctx_new` or `sss_ctx_new_in` with `k_max >= k`.
+ */
+int sss_combine_shares_ctx(sss_Ctx *ctx,
+                           uint8_t *data,
+                           const sss_Share *shares,
+                           uint8_t k);
+
+
+/*
+ * Refresh the `n` shares in `shares` that were created with a threshold of
+ * `k`, without restoring the secret. Afterwards, any `k` of the refreshed
+ * shares still restore the same secret, but the old shares can no longer be
+ * combined with the new ones. See `sss_refresh_keyshares` in `hazmat.h`.
+ *
+ * All of the shares of the secret must be refreshed at the same time, and the
+ * old shares should be destroyed.
+ */
+void sss_refresh_shares(sss_Share *shares, uint8_t n, uint8_t k);
+
+
+/*
+ * Same as `sss_refresh_shares`, but using the workspace in `ctx`, which must
+ * have been allocated by `sss_ctx_new` with `n_max >= n` and `k_max >= k`.
+ */
+void sss_refresh_shares_ctx(sss_Ctx *ctx,
+                            sss_Share *shares,
+                            uint8_t n,
+                            uint8_t k);
+
+
+/*
+ * Move the secret of the `k` shares in `shares` to a new policy: write `n2`
+ * new shares with a threshold of `k2` to `out`, without restoring the secret.
+ * See `sss_reshare_keyshares` in `hazmat.h`. The new shares cannot be
+ * combined with the old shares.
+ *
+ * This function does not check whether the old shares are valid; an invalid
+ * share results in new shares that do not restore the secret. It returns -1
+ * if the shares do not all carry the same ciphertext, and 0 otherwise.
+ */
+int sss_reshare_shares(sss_Share *out,
+                       const sss_Share *shares,
+                       uint8_t k,
+                       uint8_t n2,
+                       uint8_t k2);
+
+
+/*
+ * Same as `sss_reshare_shares`, but using the workspace in `ctx`, which must
+ * have been allocated by `sss_ctx_new` with `n_max >= n2`, `k_max >= k` and
+ * `k_max >= k2`.
+ */
+int sss_reshare_shares_ctx(sss_Ctx *ctx,
+                           sss_Share *out,
+                           const sss_Share *shares,
+                           uint8_t k,
+                           uint8_t n2,
+                           uint8_t k2);
+
+
+/*
+ * State for combining shares one at a time, as they arrive (for example from
+ * different people). See `sss_KeyshareCombiner` in `hazmat.h`.
+ */
+typedef struct sss_Combiner sss_Combiner;
+
+
+/*
+ * Allocate a new incremental combiner for at most `k` shares.
+ *
+ * Returns NULL if the memory could not be allocated.
+ */
+sss_Combiner* sss_combiner_new(uint8_t k);
+
+
+/*
+ * Add the share `share` to `combiner`. This costs O(k).
+ *
+ * Returns 0 on success. Returns -1 (without changing the state) if `share`
+ * does not belong to the same secret as the shares that were added before,
+ * if the combiner is already full, or if a share with the same index was
+ * already added.
+ */
+int sss_combiner_add(sss_Combiner *combiner, const sss_Share *share);
+
+
+/*
+ * Restore the secret from the shares that were added to `combiner` and write
+ * it to `data`. The caller has to ensure that the `data` array will fit at
+ * least `sss_MLEN` bytes. This costs O(1) besides decrypting the data.
+ *
+ * Returns 0 on success and -1 otherwise, exactly like `sss_combine_shares`.
+ */
+int sss_combiner_finalize(const sss_Combiner *combiner, uint8_t *data);
+
+
+/*
+ * Wipe the state of `combiner` and free it.
+ */
+void sss_combiner_free(sss_Combiner *combiner);
+
+
+/*
+ * Version of the share header of `sss_VersionedShare`
+ */
+#define sss_SHARE_VERSION 1
+
+
+/*
+ * Length of the share header (version and threshold)
+ */
+#define sss_HEADER_LEN 2
+
+
+/*
+ * Length of a versioned share
+ */
+#define sss_VERSIONED_SHARE_LEN (sss_HEADER_LEN + sss_SHARE_LEN)
+
+
+/*
+ * One share of a secret, prefixed by a header that holds the version of the
+ * share format and the threshold `k`. The header is bound to the ciphertext
+ * (through the AEAD nonce), so it cannot be changed without the combine step
+ * failing.
+ */
+typedef uint8_t sss_VersionedShare[sss_VERSIONED_SHARE_LEN];
+
+
+/*
+ * Same as `sss_create_shares`, but for versioned shares.
+ */
+void sss_create_versioned_shares(sss_VersionedShare *out,
+                                 const uint8_t *data,
+                                 uint8_t n,
+                                 uint8_t k);
+
+
+/*
+ * Return the threshold that is stored in the header of `share`. This value
+ * is not authenticated until the shares are combined.
+ */
+uint8_t sss_versioned_share_threshold(const sss_VersionedShare *share);
+
+
+/*
+ * Combine the `count` versioned shares pointed to by `shares` and put the
+ * resulting secret data in `data`. The caller has to ensure that the `data`
+ * array will fit at least `sss_MLEN` bytes.
+ *
+ * Only the first `k` shares with distinct x values (where `k` is the threshold
+ * from the header) are used to restore the secret, so passing more shares
+ * than needed does not make this function slower. If `spot_check` is
+ * nonzero, every other share is checked against the restored polynomial
+ * (which costs O(k) per share), and the function fails if any of them does
+ * not match.
+ *
+ * Returns 0 on success, and -1 if the secret could not be restored.
+ */
+int sss_combine_versioned_shares(uint8_t *data,
+                                 const sss_VersionedShare *shares,
+                                 uint8_t count,
+                                 int spot_check);
+
+
+/*
+ * A dealer-side handle that creates shares of one secret on demand. See
+ * `sss_KeyshareGenerator` in `hazmat.h`.
+ */
+typedef struct sss_ShareGenerator sss_ShareGenerator;
+
+
+/*
+ * Create a generator for shares of the secret data `data` with a threshold
+ * value given in `k`. All of the randomness (including the encryption key) is
+ * derived from `seed` and `data`, so a generator that is created from the
+ * same data and seed creates exactly the same shares. A seed must never be
+ * reused for different data. If `seed` is NULL, a random seed is generated.
+ * If `arena` is not NULL, the polynomial is kept in (locked) memory from
+ * `arena`.
+ *
+ * Returns NULL if the memory could not be allocated.
+ */
+sss_ShareGenerator* sss_share_generator_new(sss_Arena *arena,
+                                            const uint8_t *data,
+                                            const uint8_t seed[32],
+                                            uint8_t k);
+
+
+/*
+ * Write the seed of `gen` to `seed`. Anyone who knows the seed can check a
+ * guess of the secret against the shares, so it must be treated as a secret
+ * value.
+ */
+void sss_share_generator_seed(const sss_ShareGenerator *gen, uint8_t seed[32]);
+
+
+/*
+ * Create the share with index `x` (in 1..255) and write it to `out`.
+ *
+ * Returns 0 on success, and -1 if `x` is 0.
+ */
+int sss_share_generator_get(const sss_ShareGenerator *gen,
+                            sss_Share *out,
+                            uint8_t x);
+
+
+/*
+ * Wipe the state of `gen` and free it.
+ */
+void sss_share_generator_free(sss_ShareGenerator *gen);
+
+
 #endif /* sss_SSS_H_ */
@@ -0,0 +1,139 @@
+/*
+ * AEAD wrapper around the Secret shared data, in GF(2^16)
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * This is `sss.c` for the GF(2^16) key shares in `hazmat16.c`. The data is
+ * encrypted in exactly the same way. The key shares are copied to a scratch
+ * buffer on the heap, because a committee of thousands of holders does not
+ * fit on the stack.
+ */
+
+
+#include "randombytes.h"
+#include "arena.h"
+#include "tweetnacl.h"
+#include "sss16.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * Nonce for the `crypto_secretbox` authenticated encryption.
+ * The nonce is constant (zero), because we are using an ephemeral key.
+ */
+static const unsigned char nonce[crypto_secretbox_NONCEBYTES] = { 0 };
+
+
+uint16_t sss_share16_x(const sss_Share16 share)
+{
+	return sss_keyshare16_x(share);
+}
+
+
+int sss_create_shares16(sss_Share16 *out, const uint8_t *data,
+                        uint16_t n, uint16_t k)
+{
+	unsigned char key[32];
+	unsigned char m[crypto_secretbox_ZEROBYTES + sss_MLEN] = { 0 };
+	unsigned char c[sizeof(m)];
+	sss_Keyshare16 *keyshares;
+	size_t idx;
+	int tmp;
+
+	keyshares = malloc(n * sizeof(sss_Keyshare16));
+	if (keyshares == NULL) return -1;
+
+	/* Generate a random encryption key */
+	randombytes(key, sizeof(key));
+
+	/* AEAD encrypt the data with the key */
+	memcpy(&m[crypto_secretbox_ZEROBYTES], data, sss_MLEN);
+	tmp = crypto_secretbox(c, m, sizeof(m), nonce, key);
+	assert(tmp == 0); /* should always happen */
+
+	/* Generate KeyShares */
+	if (sss_create_keyshares16(keyshares, key, n, k) != 0) {
+		sss_memzero(key, sizeof(key));
+		sss_memzero(m, sizeof(m));
+		free(keyshares);
+		return -1;
+	}
+
+	/* Build regular shares */
+	for (idx = 0; idx < n; idx++) {
+		memcpy(&out[idx][0], keyshares[idx], sss_KEYSHARE16_LEN);
+		memcpy(&out[idx][sss_KEYSHARE16_LEN],
+		       &c[crypto_secretbox_BOXZEROBYTES], sss_CLEN);
+	}
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
+	sss_memzero(keyshares, n * sizeof(sss_Keyshare16));
+	free(keyshares);
+	return 0;
+}
+
+
+/*
+ * Combine the shares, using `weights` if it is not NULL
+ */
+static int combine_shares16(uint8_t *data, const sss_Share16 *shares,
+                            const uint16_t *weights, uint16_t k)
+{
+	unsigned char key[crypto_secretbox_KEYBYTES];
+	unsigned char c[crypto_secretbox_BOXZEROBYTES + sss_CLEN] = { 0 };
+	unsigned char m[sizeof(c)];
+	sss_Keyshare16 *keyshares;
+	size_t idx;
+	int ret = 0;
+
+	/* Check if all ciphertexts are the same */
+	if (k < 1) return -1;
+	for (idx = 1; idx < k; idx++) {
+		if (memcmp(&shares[0][sss_KEYSHARE16_LEN],
+		           &shares[idx][sss_KEYSHARE16_LEN], sss_CLEN) != 0) {
+			return -1;
+		}
+	}
+
+	/* Restore the key */
+	keyshares = malloc(k * sizeof(sss_Keyshare16));
+	if (keyshares == NULL) return -1;
+	for (idx = 0; idx < k; idx++) {
+		memcpy(keyshares[idx], &shares[idx][0], sss_KEYSHARE16_LEN);
+	}
+	if (weights != NULL) {
+		sss_combine_keyshares16_weights(key,
+		      (const sss_Keyshare16*) keyshares, weights, k);
+	} else {
+		ret = sss_combine_keyshares16(key,
+		      (const sss_Keyshare16*) keyshares, k);
+	}
+	sss_memzero(keyshares, k * sizeof(sss_Keyshare16));
+	free(keyshares);
+	if (ret != 0) return -1;
+
+	/* Decrypt the ciphertext */
+	memcpy(&c[crypto_secretbox_BOXZEROBYTES],
+	       &shares[0][sss_KEYSHARE16_LEN], sss_CLEN);
+	ret |= crypto_secretbox_open(m, c, sizeof(c), nonce, key);
+	memcpy(data, &m[crypto_secretbox_ZEROBYTES], sss_MLEN);
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
+	return ret;
+}
+
+
+int sss_combine_shares16(uint8_t *data, const sss_Share16 *shares,
+                         uint16_t k)
+{
+	return combine_shares16(data, shares, NULL, k);
+}
+
+
+int sss_combine_shares16_weights(uint8_t *data, const sss_Share16 *shares,
+                                 const uint16_t *weights, uint16_t k)
+{
+	return combine_shares16(data, shares, weights, k);
+}
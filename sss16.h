@@ -0,0 +1,75 @@
+/*
+ * Intermediate level API for Daan Sprenkels' Shamir secret sharing library,
+ * in GF(2^16)
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Same as `sss.h`, but for committees of up to 65535 holders. See
+ * `hazmat16.h`.
+ */
+
+
+#ifndef sss_SSS16_H_
+#define sss_SSS16_H_
+
+#include "hazmat16.h"
+#include "sss.h"
+#include <inttypes.h>
+
+
+/*
+ * Length of a SSS share in GF(2^16)
+ */
+#define sss_SHARE16_LEN (sss_CLEN + sss_KEYSHARE16_LEN)
+
+
+/*
+ * One share of a secret which is shared using Shamir's
+ * the `sss_create_shares16` function.
+ */
+typedef uint8_t sss_Share16[sss_SHARE16_LEN];
+
+
+/*
+ * Return the x value of `share`.
+ */
+uint16_t sss_share16_x(const sss_Share16 share);
+
+
+/*
+ * Create `n` shares of the secret data `data`. Share such that `k` or more
+ * shares will be able to restore the secret. The caller has to guarantee
+ * that `out` will fit at least `n` instances of `sss_Share16`.
+ *
+ * Returns 0 on success, and -1 if the scratch space could not be allocated.
+ */
+int sss_create_shares16(sss_Share16 *out,
+                        const uint8_t *data,
+                        uint16_t n,
+                        uint16_t k);
+
+
+/*
+ * Combine the `k` shares pointed to by `shares` and put the resulting secret
+ * data in `data`, like `sss_combine_shares`.
+ *
+ * Returns 0 on success, and -1 if combining the secret failed (or if the
+ * scratch space could not be allocated).
+ */
+int sss_combine_shares16(uint8_t *data,
+                         const sss_Share16 *shares,
+                         uint16_t k);
+
+
+/*
+ * Same as `sss_combine_shares16`, but using the Lagrange weights that were
+ * computed by `sss_lagrange_weights16` for the x values of these shares (in
+ * the same order). Use this to combine many secrets that were given to the
+ * same holders, in O(k) per secret.
+ */
+int sss_combine_shares16_weights(uint8_t *data,
+                                 const sss_Share16 *shares,
+                                 const uint16_t *weights,
+                                 uint16_t k);
+
+
+#endif /* sss_SSS16_H_ */
@@ -0,0 +1,130 @@
+/*
+ * Per-thread performance counters
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * Every thread that counts gets a block of counters from a global list.
+ * Only the owning thread writes to a block (with relaxed atomic stores), and
+ * `sss_stats_snapshot` reads all of the blocks (with relaxed atomic loads),
+ * so neither of them needs a lock. Blocks are pushed onto the list with a
+ * compare-and-swap and are never freed. When a thread exits, its block is
+ * handed to the next new thread, which keeps adding to the same counters,
+ * so the list only grows to the largest number of threads that were alive
+ * at the same time.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "stats.h"
+#include <string.h>
+
+#ifdef sss_STATS
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+#define STATS_FIELDS (sizeof(sss_Stats) / sizeof(uint64_t))
+
+
+typedef struct Block {
+	sss_Stats stats;
+	struct Block *next;
+	int in_use;
+} Block;
+
+
+__thread sss_Stats *sss_stats_local;
+
+static Block *blocks;
+static pthread_key_t release_key;
+static pthread_once_t release_once = PTHREAD_ONCE_INIT;
+
+
+static void release_block(void *arg)
+{
+	Block *block = arg;
+	__atomic_store_n(&block->in_use, 0, __ATOMIC_RELEASE);
+}
+
+
+static void init_release_key(void)
+{
+	pthread_key_create(&release_key, release_block);
+}
+
+
+sss_Stats* sss_stats_register(void)
+{
+	Block *block;
+	int expected;
+
+	pthread_once(&release_once, init_release_key);
+
+	/* Reuse the block of a thread that has exited */
+	for (block = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); block != NULL;
+	     block = block->next) {
+		expected = 0;
+		if (__atomic_compare_exchange_n(&block->in_use, &expected, 1, 0,
+		                                __ATOMIC_ACQUIRE,
+		                                __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+
+	if (block == NULL) {
+		block = calloc(1, sizeof(*block));
+		if (block == NULL) return NULL;
+		block->in_use = 1;
+		block->next = __atomic_load_n(&blocks, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&blocks, &block->next, block, 0,
+		                                    __ATOMIC_RELEASE,
+		                                    __ATOMIC_RELAXED)) {}
+	}
+	pthread_setspecific(release_key, block);
+	sss_stats_local = &block->stats;
+	return sss_stats_local;
+}
+
+
+uint64_t sss_stats_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return (uint64_t) hi << 32 | lo;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+int sss_stats_snapshot(sss_Stats *out)
+{
+	uint64_t *sum = (uint64_t*) out;
+	Block *block;
+	size_t idx;
+
+	memset(out, 0, sizeof(*out));
+	for (block = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); block != NULL;
+	     block = block->next) {
+		for (idx = 0; idx < STATS_FIELDS; idx++) {
+			sum[idx] += __atomic_load_n(&((uint64_t*) &block->stats)[idx],
+			                            __ATOMIC_RELAXED);
+		}
+	}
+	return 0;
+}
+
+#else
+
+int sss_stats_snapshot(sss_Stats *out)
+{
+	memset(out, 0, sizeof(*out));
+	return -1;
+}
+
+#endif /* sss_STATS */
@@ -0,0 +1,89 @@
+/*
+ * Performance counters for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * When the library is built with `make STATS=1` (which defines `sss_STATS`),
+ * every thread counts the calls it makes into the library and the time it
+ * spends in each phase of creating and combining shares. The counters are
+ * kept per thread, so counting never takes a lock, and
+ * `sss_stats_snapshot` adds up the counters of all threads.
+ *
+ * Without `sss_STATS`, none of the counting code is compiled in.
+ */
+
+
+#ifndef sss_STATS_H_
+#define sss_STATS_H_
+
+#include <inttypes.h>
+
+
+/*
+ * The counters. The `_ticks` fields count CPU cycles (with `rdtsc`) on x86
+ * and nanoseconds elsewhere. The phases nest: the time that is spent on
+ * randomness and transposes while creating or combining key shares also
+ * counts for the key share phases.
+ */
+typedef struct {
+	/* sss_create_shares and sss_combine_shares (and their _ctx variants) */
+	uint64_t create_calls, combine_calls, combine_failures;
+	uint64_t bytes_created, bytes_combined;
+
+	/* sss_create_keyshares and sss_combine_keyshares (and _ctx) */
+	uint64_t create_keyshares_calls, combine_keyshares_calls;
+
+	/* Field operations on 32 elements at once */
+	uint64_t gf256_muls, gf256_invs;
+
+	/* Time per phase */
+	uint64_t randomness_ticks, aead_ticks;
+	uint64_t keyshare_create_ticks, keyshare_combine_ticks;
+	uint64_t transpose_ticks;
+} sss_Stats;
+
+
+/*
+ * Write the sum of the counters of all threads (including the threads that
+ * have exited) to `out`. The counters of other threads are read while they
+ * are running, so the snapshot may be a few operations behind.
+ *
+ * Returns 0 on success, and -1 (with all counters set to 0) if the library
+ * was built without `sss_STATS`.
+ */
+int sss_stats_snapshot(sss_Stats *out);
+
+
+/*
+ * Instrumentation hooks, used by the library itself
+ */
+#ifdef sss_STATS
+
+/* The counters of the current thread, or NULL before its first count */
+extern __thread sss_Stats *sss_stats_local;
+
+sss_Stats* sss_stats_register(void);
+uint64_t sss_stats_ticks(void);
+
+#define sss_STATS_ADD(field, n)                                               \
+	do {                                                                  \
+		sss_Stats *stats_ = sss_stats_local != NULL ? sss_stats_local \
+		                                            : sss_stats_register(); \
+		if (stats_ != NULL) {                                         \
+			__atomic_store_n(&stats_->field, stats_->field + (n), \
+			                 __ATOMIC_RELAXED);                   \
+		}                                                             \
+	} while (0)
+#define sss_STATS_START(var) uint64_t var = sss_stats_ticks()
+#define sss_STATS_PHASE(field, start) \
+	sss_STATS_ADD(field, sss_stats_ticks() - (start))
+
+#else
+
+#define sss_STATS_ADD(field, n) ((void) 0)
+#define sss_STATS_START(var)
+#define sss_STATS_PHASE(field, start) ((void) 0)
+
+#endif /* sss_STATS */
+
+
+#endif /* sss_STATS_H_ */
@@ -0,0 +1,198 @@
+/*
+ * Shares with a Merkle authentication path
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * The tree has 2^sss_TAG_DEPTH leaves. Leaf `x - 1` is the hash of the key
+ * share with x value `x`, and the other leaves are empty (all zeroes).
+ * Domain separation is done with a prefix byte: leaves are hashed as
+ * H(0x00 || keyshare), inner nodes as H(0x01 || left || right). H is SHA-512
+ * truncated to `sss_TAG_HASH_LEN` bytes.
+ *
+ * A tagged share is laid out like this:
+ *
+ *     | keyshare | ciphertext | root | path[0] | ... | path[DEPTH - 1] |
+ *
+ * where `path[0]` is the sibling of the leaf. The first part is exactly a
+ * regular `sss_Share`. The nonce of the AEAD is the first
+ * `crypto_secretbox_NONCEBYTES` bytes of the root.
+ */
+
+#include "randombytes.h"
+#include "tweetnacl.h"
+#include "arena.h"
+#include "tagged.h"
+#include <assert.h>
+#include <string.h>
+
+
+#if crypto_secretbox_NONCEBYTES > sss_TAG_HASH_LEN
+# error "crypto_secretbox_NONCEBYTES size is invalid"
+#endif
+
+
+#define ROOT_OFFSET sss_SHARE_LEN
+#define PATH_OFFSET (sss_SHARE_LEN + sss_TAG_HASH_LEN)
+
+
+static void hash_leaf(uint8_t out[sss_TAG_HASH_LEN], const uint8_t *keyshare)
+{
+	uint8_t in[1 + sss_KEYSHARE_LEN], h[crypto_hash_BYTES];
+
+	in[0] = 0x00;
+	memcpy(&in[1], keyshare, sss_KEYSHARE_LEN);
+	crypto_hash(h, in, sizeof(in));
+	memcpy(out, h, sss_TAG_HASH_LEN);
+}
+
+
+static void hash_node(uint8_t out[sss_TAG_HASH_LEN],
+                      const uint8_t left[sss_TAG_HASH_LEN],
+                      const uint8_t right[sss_TAG_HASH_LEN])
+{
+	uint8_t in[1 + 2 * sss_TAG_HASH_LEN], h[crypto_hash_BYTES];
+
+	in[0] = 0x01;
+	memcpy(&in[1], left, sss_TAG_HASH_LEN);
+	memcpy(&in[1 + sss_TAG_HASH_LEN], right, sss_TAG_HASH_LEN);
+	crypto_hash(h, in, sizeof(in));
+	memcpy(out, h, sss_TAG_HASH_LEN);
+}
+
+
+/*
+ * Compute the root from the key share in `share` and its authentication path
+ */
+static void compute_root(uint8_t root[sss_TAG_HASH_LEN],
+                         const sss_TaggedShare *share)
+{
+	const uint8_t *path = &(*share)[PATH_OFFSET];
+	size_t level, pos = (*share)[0] - 1;
+
+	hash_leaf(root, &(*share)[0]);
+	for (level = 0; level < sss_TAG_DEPTH; level++) {
+		if (pos & 1) {
+			hash_node(root, &path[level * sss_TAG_HASH_LEN], root);
+		} else {
+			hash_node(root, root, &path[level * sss_TAG_HASH_LEN]);
+		}
+		pos >>= 1;
+	}
+}
+
+
+void sss_create_tagged_shares(sss_TaggedShare *out,
+                              const uint8_t *data,
+                              uint8_t n,
+                              uint8_t k)
+{
+	/*
+	 * One level of the tree at a time, starting with the leaves. Every
+	 * level is hashed in place, and the entry after the last node is the
+	 * empty (all zeroes) sibling of an odd node out.
+	 */
+	uint8_t nodes[n + 1][sss_TAG_HASH_LEN];
+	unsigned char key[crypto_secretbox_KEYBYTES];
+	unsigned char m[crypto_secretbox_ZEROBYTES + sss_MLEN] = { 0 };
+	unsigned char c[sizeof(m)];
+	sss_Keyshare keyshares[n];
+	size_t level, idx, width;
+	int tmp;
+
+	assert(n != 0);
+
+	/* Generate a random encryption key and share it */
+	randombytes(key, sizeof(key));
+	sss_create_keyshares(keyshares, key, n, k);
+
+	/* Walk up the Merkle tree, and copy every sibling into the paths */
+	for (idx = 0; idx < n; idx++) {
+		hash_leaf(nodes[idx], keyshares[idx]);
+	}
+	for (level = 0, width = n; level < sss_TAG_DEPTH; level++) {
+		memset(nodes[width], 0, sss_TAG_HASH_LEN);
+		for (idx = 0; idx < n; idx++) {
+			memcpy(&out[idx][PATH_OFFSET + level * sss_TAG_HASH_LEN],
+			       nodes[(idx >> level) ^ 1], sss_TAG_HASH_LEN);
+		}
+		width = (width + 1) / 2;
+		for (idx = 0; idx < width; idx++) {
+			hash_node(nodes[idx], nodes[2 * idx], nodes[2 * idx + 1]);
+		}
+	}
+
+	/* AEAD encrypt the data with the key and a nonce from the root */
+	memcpy(&m[crypto_secretbox_ZEROBYTES], data, sss_MLEN);
+	tmp = crypto_secretbox(c, m, sizeof(m), nodes[0], key);
+	assert(tmp == 0); /* should always happen */
+
+	/* Fill in the rest of the tagged shares */
+	for (idx = 0; idx < n; idx++) {
+		memcpy(&out[idx][0], keyshares[idx], sss_KEYSHARE_LEN);
+		memcpy(&out[idx][sss_KEYSHARE_LEN],
+		       &c[crypto_secretbox_BOXZEROBYTES], sss_CLEN);
+		memcpy(&out[idx][ROOT_OFFSET], nodes[0], sss_TAG_HASH_LEN);
+	}
+
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
+	sss_memzero(keyshares, sizeof(keyshares));
+}
+
+
+void sss_tagged_share_root(uint8_t root[sss_TAG_HASH_LEN],
+                           const sss_TaggedShare *share)
+{
+	memcpy(root, &(*share)[ROOT_OFFSET], sss_TAG_HASH_LEN);
+}
+
+
+int sss_verify_tagged_share(const sss_TaggedShare *share,
+                            const uint8_t root[sss_TAG_HASH_LEN])
+{
+	uint8_t computed[sss_TAG_HASH_LEN];
+
+	if ((*share)[0] == 0) return -1;
+	if (root == NULL) root = &(*share)[ROOT_OFFSET];
+	compute_root(computed, share);
+	return crypto_verify_32(computed, root);
+}
+
+
+int sss_combine_tagged_shares(uint8_t *data,
+                              const sss_TaggedShare *shares,
+                              uint8_t k)
+{
+	unsigned char key[crypto_secretbox_KEYBYTES];
+	unsigned char c[crypto_secretbox_BOXZEROBYTES + sss_CLEN] = { 0 };
+	unsigned char m[sizeof(c)];
+	uint8_t root[sss_TAG_HASH_LEN];
+	sss_Keyshare keyshares[k];
+	size_t idx;
+	int ret = 0;
+
+	if (k < 1) return -1;
+
+	/* Check all of the shares against the same root and ciphertext */
+	sss_tagged_share_root(root, &shares[0]);
+	for (idx = 0; idx < k; idx++) {
+		if (sss_verify_tagged_share(&shares[idx], root) != 0 ||
+		    memcmp(&shares[0][sss_KEYSHARE_LEN],
+		           &shares[idx][sss_KEYSHARE_LEN], sss_CLEN) != 0) {
+			return -1;
+		}
+		memcpy(keyshares[idx], &shares[idx][0], sss_KEYSHARE_LEN);
+	}
+
+	/* Restore the key and decrypt the ciphertext */
+	sss_combine_keyshares(key, (const sss_Keyshare*) keyshares, k);
+	memcpy(&c[crypto_secretbox_BOXZEROBYTES],
+	       &shares[0][sss_KEYSHARE_LEN], sss_CLEN);
+	ret |= crypto_secretbox_open(m, c, sizeof(c), root, key);
+	memcpy(data, &m[crypto_secretbox_ZEROBYTES], sss_MLEN);
+
+	sss_memzero(key, sizeof(key));
+	sss_memzero(m, sizeof(m));
+	sss_memzero(keyshares, sizeof(keyshares));
+	return ret;
+}
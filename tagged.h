@@ -0,0 +1,96 @@
+/*
+ * Tagged shares for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * A regular share can only be checked after the secret is restored (when the
+ * AEAD tag is checked), and a failure does not tell which share was bad. A
+ * tagged share additionally carries a Merkle authentication path for its key
+ * share. Every tagged share of the same secret has the same Merkle root, so
+ * a single share can be checked against that root as soon as it arrives,
+ * with a constant amount of work.
+ *
+ * The root is bound to the ciphertext (the AEAD nonce is derived from it), so
+ * a consistent set of shares with a forged root will still fail to decrypt.
+ */
+
+
+#ifndef sss_TAGGED_H_
+#define sss_TAGGED_H_
+
+#include "sss.h"
+
+
+/*
+ * Depth of the Merkle tree (enough for 255 shares)
+ */
+#define sss_TAG_DEPTH 8
+
+
+/*
+ * Length of a Merkle root, and of every node in an authentication path
+ */
+#define sss_TAG_HASH_LEN 32
+
+
+/*
+ * Length of a tagged share: a regular share, followed by the Merkle root and
+ * the authentication path
+ */
+#define sss_TAGGED_SHARE_LEN (sss_SHARE_LEN + (1 + sss_TAG_DEPTH) * sss_TAG_HASH_LEN)
+
+
+/*
+ * One tagged share of a secret, which is created by `sss_create_tagged_shares`
+ */
+typedef uint8_t sss_TaggedShare[sss_TAGGED_SHARE_LEN];
+
+
+/*
+ * Create `n` tagged shares of the secret data `data`. Share such that `k` or
+ * more shares will be able to restore the secret.
+ *
+ * This function will put the resulting shares in the array pointed to by
+ * `out`. The caller has to guarantee that this array will fit at least `n`
+ * instances of `sss_TaggedShare`.
+ */
+void sss_create_tagged_shares(sss_TaggedShare *out,
+                              const uint8_t *data,
+                              uint8_t n,
+                              uint8_t k);
+
+
+/*
+ * Write the Merkle root of `share` to `root`. The dealer may publish the root
+ * through a trusted channel, so that shares can be checked against it.
+ */
+void sss_tagged_share_root(uint8_t root[sss_TAG_HASH_LEN],
+                           const sss_TaggedShare *share);
+
+
+/*
+ * Check if `share` is a valid share for the Merkle root `root`. If `root` is
+ * NULL, the root that is stored in `share` itself is used, which only checks
+ * that the share is internally consistent.
+ *
+ * This costs `sss_TAG_DEPTH + 1` hashes, regardless of the threshold and of
+ * the number of shares. Returns 0 if the share is valid, and -1 otherwise.
+ */
+int sss_verify_tagged_share(const sss_TaggedShare *share,
+                            const uint8_t root[sss_TAG_HASH_LEN]);
+
+
+/*
+ * Combine the `k` tagged shares pointed to by `shares` and put the resulting
+ * secret data in `data`. The caller has to ensure that the `data` array will
+ * fit at least `sss_MLEN` bytes.
+ *
+ * All of the shares are checked against the root of the first share before
+ * the secret is restored. Returns 0 on success, and -1 if any of the shares
+ * is invalid or if the secret could not be restored.
+ */
+int sss_combine_tagged_shares(uint8_t *data,
+                              const sss_TaggedShare *shares,
+                              uint8_t k);
+
+
+#endif /* sss_TAGGED_H_ */
@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "archive.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define COUNT 1000
+
+int main(void)
+{
+	static unsigned char data[COUNT][sss_MLEN];
+	static sss_Share shares[COUNT * 3];
+	unsigned char restored[sss_MLEN];
+	uint8_t header[sss_STREAM_HEADER_LEN], record[sss_STREAM_RECORD_LEN];
+	uint64_t ids[COUNT];
+	const char *path = "test_archive.sssa";
+	const sss_Share *found;
+	sss_Archive *archive;
+	struct stat st;
+	FILE *file;
+	size_t idx;
+
+	/* Ids in a scrambled order */
+	for (idx = 0; idx < COUNT; idx++) {
+		ids[idx] = (idx * 7919) % COUNT * 1000003;
+		memset(data[idx], (int) idx, sss_MLEN);
+		sss_create_shares(&shares[idx * 3], data[idx], 3, 2);
+	}
+	assert(sss_archive_write(path, ids, (const sss_Share*) shares,
+	                         COUNT, 3) == 0);
+	assert(stat(path, &st) == 0 && (st.st_mode & 0777) == 0600);
+	assert(stat("test_archive.sssa.tmp", &st) == -1);
+
+	archive = sss_archive_open(path);
+	assert(archive != NULL);
+	assert(sss_archive_count(archive) == COUNT);
+	assert(sss_archive_shares_per_secret(archive) == 3);
+	for (idx = 0; idx < COUNT; idx++) {
+		found = sss_archive_find(archive, ids[idx]);
+		assert(found != NULL);
+		assert(((size_t) found) % sss_ARCHIVE_ALIGN == 0);
+		assert(sss_combine_shares(restored, &found[1], 2) == 0);
+		assert(memcmp(restored, data[idx], sss_MLEN) == 0);
+	}
+	assert(sss_archive_find(archive, 1) == NULL);
+
+	/* Replacing the file leaves an open archive intact */
+	assert(sss_archive_write(path, ids, (const sss_Share*) shares,
+	                         1, 3) == 0);
+	found = sss_archive_find(archive, ids[COUNT - 1]);
+	assert(found != NULL);
+	assert(sss_combine_shares(restored, found, 2) == 0);
+	assert(memcmp(restored, data[COUNT - 1], sss_MLEN) == 0);
+	sss_archive_close(archive);
+
+	/* Duplicate ids */
+	ids[5] = ids[6];
+	assert(sss_archive_write(path, ids, (const sss_Share*) shares,
+	                         COUNT, 3) == -1);
+
+	/* Empty archive */
+	assert(sss_archive_write(path, ids, (const sss_Share*) shares,
+	                         0, 3) == 0);
+	archive = sss_archive_open(path);
+	assert(archive != NULL);
+	assert(sss_archive_find(archive, ids[0]) == NULL);
+	sss_archive_close(archive);
+
+	/* A path with a directory component */
+	assert(sss_archive_write("./test_archive.sssa", ids,
+	                         (const sss_Share*) shares, 0, 3) == 0);
+	assert(stat(path, &st) == 0);
+
+	/* Not an archive */
+	file = fopen(path, "wb");
+	assert(file != NULL);
+	for (idx = 0; idx < 100; idx++) fputc('x', file);
+	fclose(file);
+	assert(sss_archive_open(path) == NULL);
+
+	remove(path);
+
+	/* Share stream headers and records */
+	sss_stream_header(header);
+	assert(sss_stream_check_header(header) == 0);
+	header[12] ^= 1;
+	assert(sss_stream_check_header(header) == -1);
+	header[12] ^= 1;
+	header[0] = 'x';
+	assert(sss_stream_check_header(header) == -1);
+	sss_stream_put_id(record, 0x0102030405060708ULL);
+	assert(record[0] == 0x08 && record[7] == 0x01);
+	assert(sss_stream_get_id(record) == 0x0102030405060708ULL);
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include "arena.h"
+#include "sss.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+int main(void)
+{
+	unsigned char data[sss_MLEN] = { 42 }, restored[sss_MLEN];
+	sss_Share shares[5];
+	sss_Arena *arena;
+	sss_Ctx *ctx;
+	uint8_t *a, *b;
+	size_t mark, idx;
+	int tmp;
+
+	arena = sss_arena_new(4096);
+	assert(arena != NULL);
+
+	/* Slabs are aligned and zeroed */
+	a = sss_arena_alloc(arena, 1);
+	b = sss_arena_alloc(arena, 100);
+	assert(a != NULL && b != NULL);
+	assert((uintptr_t) a % sss_ARENA_ALIGN == 0);
+	assert((uintptr_t) b % sss_ARENA_ALIGN == 0);
+	assert(b - a == sss_ARENA_ALIGN);
+
+	/* Released slabs are wiped */
+	mark = sss_arena_mark(arena);
+	a = sss_arena_alloc(arena, 32);
+	memset(a, 0xff, 32);
+	sss_arena_release(arena, mark);
+	b = sss_arena_alloc(arena, 32);
+	assert(a == b);
+	for (idx = 0; idx < 32; idx++) assert(b[idx] == 0);
+
+	/* Running out of space */
+	assert(sss_arena_alloc(arena, 1 << 20) == NULL);
+	sss_arena_reset(arena);
+	assert(sss_arena_mark(arena) == 0);
+	sss_arena_free(arena);
+
+	/* Workspace in an arena */
+	arena = sss_arena_new(8192);
+	assert(arena != NULL);
+	ctx = sss_ctx_new_in(arena, 5, 5);
+	assert(ctx != NULL);
+	sss_create_shares_ctx(ctx, shares, data, 5, 3);
+	tmp = sss_combine_shares_ctx(ctx, restored, (const sss_Share*) shares, 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	sss_ctx_free(ctx);
+	assert(sss_ctx_new_in(arena, 255, 255) == NULL);
+	sss_arena_free(arena);
+
+	/* An arena that is sized for two workspaces fits exactly two */
+	arena = sss_arena_new(2 * sss_ctx_arena_size(255, 255));
+	assert(arena != NULL);
+	assert(sss_ctx_new_in(arena, 255, 255) != NULL);
+	assert(sss_ctx_new_in(arena, 255, 255) != NULL);
+	assert(sss_ctx_new_in(arena, 255, 255) == NULL);
+	sss_arena_free(arena);
+
+	return 0;
+}
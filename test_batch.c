@@ -0,0 +1,128 @@
+#include "arena.h"
+#include "batch.h"
+#include <assert.h>
+#include <string.h>
+
+#define COUNT 100
+
+static void test_batch(sss_Threadpool *pool)
+{
+	static unsigned char data[COUNT * sss_MLEN], restored[COUNT * sss_MLEN];
+	static sss_Share shares[COUNT * 5], old[COUNT * 5], moved[COUNT * 7];
+	int status[COUNT];
+	size_t idx;
+	int tmp;
+
+	for (idx = 0; idx < sizeof(data); idx++) data[idx] = idx;
+
+	tmp = sss_create_shares_batch(pool, shares, data, COUNT, 5, 3);
+	assert(tmp == 0);
+
+	/* Refreshing changes every key share, but not the ciphertexts */
+	memcpy(old, shares, sizeof(shares));
+	tmp = sss_refresh_shares_batch(pool, shares, COUNT, 5, 3);
+	assert(tmp == 0);
+	for (idx = 0; idx < COUNT * 5; idx++) {
+		assert(old[idx][0] == shares[idx][0]);
+		assert(memcmp(old[idx], shares[idx], sss_KEYSHARE_LEN) != 0);
+		assert(memcmp(&old[idx][sss_KEYSHARE_LEN],
+		              &shares[idx][sss_KEYSHARE_LEN], sss_CLEN) == 0);
+	}
+
+	/* Old shares do not combine with new shares */
+	memcpy(old[0], shares[0], sizeof(sss_Share));
+	tmp = sss_combine_shares(restored, (const sss_Share*) old, 3);
+	assert(tmp == -1);
+
+	/* Take the first 3 shares of every secret, but keep them contiguous */
+	for (idx = 0; idx < COUNT; idx++) {
+		memmove(&shares[idx * 3], &shares[idx * 5], 3 * sizeof(sss_Share));
+	}
+	tmp = sss_combine_shares_batch(pool, restored, status,
+	                               (const sss_Share*) shares, COUNT, 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sizeof(data)) == 0);
+	for (idx = 0; idx < COUNT; idx++) assert(status[idx] == 0);
+
+	/* Move every secret to a 4-of-7 policy */
+	tmp = sss_reshare_shares_batch(pool, moved, status,
+	                               (const sss_Share*) shares, COUNT, 3, 7, 4);
+	assert(tmp == 0);
+	for (idx = 0; idx < COUNT; idx++) {
+		memmove(&moved[idx * 4], &moved[idx * 7 + 3], 4 * sizeof(sss_Share));
+	}
+	tmp = sss_combine_shares_batch(pool, restored, status,
+	                               (const sss_Share*) moved, COUNT, 4);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sizeof(data)) == 0);
+
+	/* A corrupted share only fails its own secret */
+	shares[7 * 3 + 1][sss_KEYSHARE_LEN] ^= 1;
+	tmp = sss_combine_shares_batch(pool, restored, status,
+	                               (const sss_Share*) shares, COUNT, 3);
+	assert(tmp == -1);
+	for (idx = 0; idx < COUNT; idx++) {
+		assert(status[idx] == (idx == 7 ? -1 : 0));
+	}
+
+	/* Empty batch */
+	assert(sss_create_shares_batch(pool, shares, data, 0, 5, 3) == 0);
+	assert(sss_combine_shares_batch(pool, restored, NULL,
+	                                (const sss_Share*) shares, 0, 3) == 0);
+}
+
+static void test_batch_ctx(sss_Threadpool *pool)
+{
+	static unsigned char data[COUNT * sss_MLEN], restored[COUNT * sss_MLEN];
+	static sss_Share shares[COUNT * 5];
+	sss_Ctx *ctxs[sss_THREADPOOL_MAX];
+	size_t workers = pool != NULL ? sss_threadpool_size(pool) : 1;
+	int status[COUNT];
+	sss_Arena *arena;
+	size_t idx, round;
+
+	for (idx = 0; idx < sizeof(data); idx++) data[idx] = idx ^ 0x5a;
+
+	/* The same workspaces are reused for every batch */
+	arena = sss_arena_new(workers * sss_ctx_arena_size(5, 5));
+	assert(arena != NULL);
+	for (idx = 0; idx < workers; idx++) {
+		ctxs[idx] = sss_ctx_new_in(arena, 5, 5);
+		assert(ctxs[idx] != NULL);
+		sss_ctx_buffer_randomness(ctxs[idx], 1);
+	}
+	for (round = 0; round < 3; round++) {
+		sss_create_shares_batch_ctx(pool, ctxs, shares, data, COUNT, 5, 3);
+		for (idx = 0; idx < COUNT; idx++) {
+			memmove(&shares[idx * 3], &shares[idx * 5 + round],
+			        3 * sizeof(sss_Share));
+		}
+		assert(sss_combine_shares_batch_ctx(pool, ctxs, restored, status,
+		       (const sss_Share*) shares, COUNT, 3) == 0);
+		assert(memcmp(restored, data, sizeof(data)) == 0);
+	}
+
+	/* A corrupted share only fails its own secret */
+	shares[11 * 3][sss_KEYSHARE_LEN] ^= 1;
+	assert(sss_combine_shares_batch_ctx(pool, ctxs, restored, status,
+	       (const sss_Share*) shares, COUNT, 3) == -1);
+	for (idx = 0; idx < COUNT; idx++) {
+		assert(status[idx] == (idx == 11 ? -1 : 0));
+	}
+	for (idx = 0; idx < workers; idx++) sss_ctx_free(ctxs[idx]);
+	sss_arena_free(arena);
+}
+
+int main(void)
+{
+	sss_Threadpool *pool;
+
+	test_batch(NULL);
+	test_batch_ctx(NULL);
+	pool = sss_threadpool_new(4);
+	assert(pool != NULL);
+	test_batch(pool);
+	test_batch_ctx(pool);
+	sss_threadpool_free(pool);
+	return 0;
+}
@@ -31,8 +31,586 @@ static void test_key_shares(void)
 }
 
 
+static void test_precomputed_key_shares(void)
+{
+	uint8_t key[32], restored[32];
+	sss_Keyshare key_shares[5];
+	size_t idx;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	/* Precomputed shares are shares of the zero key */
+	sss_precompute_keyshares(key_shares, 5, 3);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) key_shares, 3);
+	for (idx = 0; idx < 32; idx++) {
+		assert(restored[idx] == 0);
+	}
+
+	sss_apply_keyshares(key_shares, key, 5);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) key_shares[2], 3);
+	assert(memcmp(key, restored, 32) == 0);
+}
+
+
+static void test_ctx_key_shares(void)
+{
+	uint8_t key[32], restored[32];
+	sss_Keyshare key_shares[255];
+	sss_Ctx *ctx;
+	size_t idx;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	ctx = sss_ctx_new(255, 128);
+	assert(ctx != NULL);
+	sss_create_keyshares_ctx(ctx, key_shares, key, 255, 127);
+	sss_combine_keyshares_ctx(ctx, restored,
+	                          (const sss_Keyshare*) key_shares[128], 127);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Same x values, so the cached weights are used */
+	key[0] ^= 1;
+	sss_create_keyshares_ctx(ctx, key_shares, key, 255, 127);
+	sss_combine_keyshares_ctx(ctx, restored,
+	                          (const sss_Keyshare*) key_shares[128], 127);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Other x values invalidate the cache */
+	sss_combine_keyshares_ctx(ctx, restored,
+	                          (const sss_Keyshare*) key_shares[3], 127);
+	assert(memcmp(key, restored, 32) == 0);
+	sss_ctx_free(ctx);
+}
+
+
+static void test_threaded_key_shares(void)
+{
+	uint8_t key[32], restored[32];
+	sss_Keyshare key_shares[255];
+	sss_Threadpool *threadpool;
+	sss_Ctx *ctx;
+	size_t idx;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	threadpool = sss_threadpool_new(4);
+	assert(threadpool != NULL);
+	assert(sss_threadpool_size(threadpool) == 4);
+	ctx = sss_ctx_new(255, 255);
+	assert(ctx != NULL);
+	sss_ctx_set_threadpool(ctx, threadpool);
+
+	sss_create_keyshares_ctx(ctx, key_shares, key, 255, 255);
+	sss_combine_keyshares_ctx(ctx, restored,
+	                          (const sss_Keyshare*) key_shares, 255);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Mixing with the single-threaded implementation */
+	sss_create_keyshares_ctx(ctx, key_shares, key, 255, 100);
+	sss_combine_keyshares(restored,
+	                      (const sss_Keyshare*) key_shares[10], 100);
+	assert(memcmp(key, restored, 32) == 0);
+	sss_combine_keyshares_ctx(ctx, restored,
+	                          (const sss_Keyshare*) key_shares[20], 100);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Small calls stay on the calling thread */
+	sss_create_keyshares_ctx(ctx, key_shares, key, 3, 2);
+	sss_combine_keyshares_ctx(ctx, restored,
+	                          (const sss_Keyshare*) key_shares[1], 2);
+	assert(memcmp(key, restored, 32) == 0);
+
+	sss_ctx_free(ctx);
+	sss_threadpool_free(threadpool);
+}
+
+
+static void test_incremental_combine(void)
+{
+	uint8_t key[32], restored[32], expected[32];
+	sss_Keyshare key_shares[255], partial[10];
+	sss_KeyshareCombiner *combiner;
+	size_t idx, idx2;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	sss_create_keyshares(key_shares, key, 255, 200);
+	combiner = sss_keyshare_combiner_new(200);
+	assert(combiner != NULL);
+	for (idx = 0; idx < 200; idx++) {
+		/* Shares may arrive in any order */
+		assert(sss_keyshare_combiner_add(combiner,
+		                                 key_shares[(idx * 7) % 255]) == 0);
+		assert(sss_keyshare_combiner_add(combiner,
+		                                 key_shares[(idx * 7) % 255]) == -1);
+		sss_keyshare_combiner_finalize(combiner, restored);
+		if (idx > 0 && idx < 10) {
+			/* Partial results match the regular combine */
+			for (idx2 = 0; idx2 <= idx; idx2++) {
+				memcpy(partial[idx2], key_shares[(idx2 * 7) % 255],
+				       sss_KEYSHARE_LEN);
+			}
+			sss_combine_keyshares(expected,
+			                      (const sss_Keyshare*) partial,
+			                      idx + 1);
+			assert(memcmp(expected, restored, 32) == 0);
+		}
+	}
+	assert(sss_keyshare_combiner_count(combiner) == 200);
+	assert(memcmp(key, restored, 32) == 0);
+	assert(sss_keyshare_combiner_add(combiner, key_shares[254]) == -1);
+	sss_keyshare_combiner_free(combiner);
+}
+
+
+static void test_robust_combine(void)
+{
+	uint8_t key[32], restored[32], faulty[255];
+	sss_Keyshare key_shares[255];
+	size_t idx;
+	int tmp;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	/* No faulty shares */
+	sss_create_keyshares(key_shares, key, 10, 4);
+	tmp = sss_combine_keyshares_robust(restored, faulty,
+	                                   (const sss_Keyshare*) key_shares,
+	                                   10, 4);
+	assert(tmp == 0);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Up to (n - k) / 2 faulty shares are corrected */
+	key_shares[1][1] ^= 0x01;
+	key_shares[5][17] ^= 0xff;
+	key_shares[5][32] ^= 0x80;
+	memset(&key_shares[8][1], 0, 32);
+	tmp = sss_combine_keyshares_robust(restored, faulty,
+	                                   (const sss_Keyshare*) key_shares,
+	                                   10, 4);
+	assert(tmp == 3);
+	assert(faulty[0] == 1 && faulty[1] == 5 && faulty[2] == 8);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* More faulty shares are detected */
+	key_shares[0][3] ^= 0x10;
+	tmp = sss_combine_keyshares_robust(restored, faulty,
+	                                   (const sss_Keyshare*) key_shares,
+	                                   10, 4);
+	assert(tmp == -1);
+
+	/* Without redundancy, nothing can be corrected */
+	sss_create_keyshares(key_shares, key, 4, 4);
+	tmp = sss_combine_keyshares_robust(restored, faulty,
+	                                   (const sss_Keyshare*) key_shares,
+	                                   4, 4);
+	assert(tmp == 0);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Large committee */
+	sss_create_keyshares(key_shares, key, 255, 100);
+	for (idx = 0; idx < 77; idx++) {
+		key_shares[idx * 3][1 + idx % 32] ^= 1 + idx;
+	}
+	tmp = sss_combine_keyshares_robust(restored, faulty,
+	                                   (const sss_Keyshare*) key_shares,
+	                                   255, 100);
+	assert(tmp == 77);
+	for (idx = 0; idx < 77; idx++) assert(faulty[idx] == idx * 3);
+	assert(memcmp(key, restored, 32) == 0);
+}
+
+
+static void test_keyshare_generator(void)
+{
+	uint8_t key[32], other[32], diff[32], restored[32], seed[32];
+	sss_Keyshare key_shares[255], again[255];
+	sss_KeyshareGenerator *gen;
+	sss_Arena *arena;
+	size_t idx, idx2;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	gen = sss_keyshare_generator_new(NULL, key, NULL, 20);
+	assert(gen != NULL);
+	assert(sss_keyshare_generator_get(gen, key_shares[0], 0) == -1);
+	for (idx = 0; idx < 255; idx++) {
+		assert(sss_keyshare_generator_get(gen, key_shares[idx],
+		                                  255 - idx) == 0);
+		assert(key_shares[idx][0] == 255 - idx);
+	}
+	sss_keyshare_generator_seed(gen, seed);
+	sss_keyshare_generator_free(gen);
+
+	/* Any k shares restore the key */
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &key_shares[100],
+	                      20);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* The same seed gives the same shares */
+	arena = sss_arena_new(4096);
+	assert(arena != NULL);
+	gen = sss_keyshare_generator_new(arena, key, seed, 20);
+	assert(gen != NULL);
+	for (idx = 0; idx < 255; idx++) {
+		sss_keyshare_generator_get(gen, again[idx], 255 - idx);
+	}
+	assert(memcmp(key_shares, again, sizeof(again)) == 0);
+	sss_keyshare_generator_free(gen);
+	sss_arena_free(arena);
+
+	/*
+	 * Another key under the same seed gets an unrelated polynomial, so a
+	 * share of each key does not reveal the difference of the keys
+	 */
+	for (idx = 0; idx < 32; idx++) {
+		other[idx] = ~key[idx];
+		diff[idx] = key[idx] ^ other[idx];
+	}
+	gen = sss_keyshare_generator_new(NULL, other, seed, 20);
+	assert(gen != NULL);
+	for (idx = 0; idx < 255; idx++) {
+		sss_keyshare_generator_get(gen, again[idx], 255 - idx);
+		for (idx2 = 0; idx2 < 32; idx2++) {
+			again[idx][1 + idx2] ^= key_shares[idx][1 + idx2];
+		}
+		assert(memcmp(&again[idx][1], diff, 32) != 0);
+	}
+	sss_keyshare_generator_free(gen);
+}
+
+
+static void test_enroll_key_shares(void)
+{
+	uint8_t key[32], restored[32], xs[250];
+	sss_Keyshare key_shares[255], enrolled[250], mixed[5];
+	size_t idx;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+	sss_create_keyshares(key_shares, key, 255, 5);
+
+	/* Enrolling an existing x value gives back the same share */
+	assert(sss_enroll_keyshare(enrolled[0],
+	                           (const sss_Keyshare*) &key_shares[10],
+	                           5, 200) == 0);
+	assert(memcmp(enrolled[0], key_shares[199], sizeof(sss_Keyshare)) == 0);
+	assert(sss_enroll_keyshare(enrolled[0],
+	                           (const sss_Keyshare*) &key_shares[10],
+	                           5, 12) == 0);
+	assert(memcmp(enrolled[0], key_shares[11], sizeof(sss_Keyshare)) == 0);
+	assert(sss_enroll_keyshare(enrolled[0],
+	                           (const sss_Keyshare*) key_shares,
+	                           5, 0) == -1);
+
+	/* Batch enrollment from the first 5 shares */
+	for (idx = 0; idx < 250; idx++) xs[idx] = idx + 6;
+	assert(sss_enroll_keyshares(enrolled, xs, 250,
+	                            (const sss_Keyshare*) key_shares, 5) == 0);
+	assert(memcmp(enrolled, &key_shares[5], sizeof(enrolled)) == 0);
+
+	/* Old and new shares combine together */
+	memcpy(mixed[0], key_shares[0], sizeof(sss_Keyshare));
+	memcpy(mixed[1], key_shares[3], sizeof(sss_Keyshare));
+	memcpy(&mixed[2], &enrolled[100], 3 * sizeof(sss_Keyshare));
+	sss_combine_keyshares(restored, (const sss_Keyshare*) mixed, 5);
+	assert(memcmp(key, restored, 32) == 0);
+}
+
+
+static void test_refresh_key_shares(void)
+{
+	uint8_t key[32], restored[32];
+	sss_Keyshare key_shares[255], subset[4], old[4];
+	sss_Ctx *ctx;
+	size_t idx;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+	sss_create_keyshares(key_shares, key, 255, 4);
+
+	/* The shares do not need to have consecutive x values */
+	for (idx = 0; idx < 4; idx++) {
+		memcpy(subset[idx], key_shares[idx * 60 + 7], sizeof(sss_Keyshare));
+	}
+	memcpy(old, subset, sizeof(old));
+	sss_refresh_keyshares(subset, 4, 4);
+	for (idx = 0; idx < 4; idx++) {
+		assert(subset[idx][0] == old[idx][0]);
+		assert(memcmp(subset[idx], old[idx], sizeof(sss_Keyshare)) != 0);
+	}
+	sss_combine_keyshares(restored, (const sss_Keyshare*) subset, 4);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Mixing old and new shares does not work */
+	memcpy(old[0], subset[0], sizeof(sss_Keyshare));
+	sss_combine_keyshares(restored, (const sss_Keyshare*) old, 4);
+	assert(memcmp(key, restored, 32) != 0);
+
+	ctx = sss_ctx_new(255, 4);
+	assert(ctx != NULL);
+	sss_refresh_keyshares_ctx(ctx, key_shares, 255, 4);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &key_shares[200],
+	                      4);
+	assert(memcmp(key, restored, 32) == 0);
+	sss_ctx_free(ctx);
+}
+
+
+static void test_reshare_key_shares(void)
+{
+	uint8_t key[32], restored[32], old_xs[3];
+	sss_Keyshare old[5], sub[3][7], received[3], fresh[7], bulk[7];
+	sss_Ctx *ctx;
+	size_t idx1, idx2;
+
+	for (idx1 = 0; idx1 < 32; idx1++) {
+		key[idx1] = idx1;
+	}
+	sss_create_keyshares(old, key, 5, 3);
+
+	/* 3-of-5 to 4-of-7, using the old shares 2, 3 and 5 */
+	for (idx1 = 0; idx1 < 3; idx1++) {
+		old_xs[idx1] = old[idx1 + (idx1 > 0) + (idx1 > 1)][0];
+		sss_reshare_keyshare(sub[idx1],
+		                     old[idx1 + (idx1 > 0) + (idx1 > 1)], 7, 4);
+	}
+	for (idx2 = 0; idx2 < 7; idx2++) {
+		for (idx1 = 0; idx1 < 3; idx1++) {
+			memcpy(received[idx1], sub[idx1][idx2], sizeof(sss_Keyshare));
+		}
+		assert(sss_combine_subshares(fresh[idx2],
+		                             (const sss_Keyshare*) received,
+		                             old_xs, 3) == 0);
+		assert(fresh[idx2][0] == idx2 + 1);
+	}
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &fresh[3], 4);
+	assert(memcmp(key, restored, 32) == 0);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &fresh[3], 3);
+	assert(memcmp(key, restored, 32) != 0);
+
+	/* Sub-shares for different new holders cannot be combined */
+	memcpy(received[0], sub[0][0], sizeof(sss_Keyshare));
+	assert(sss_combine_subshares(fresh[0], (const sss_Keyshare*) received,
+	                             old_xs, 3) == -1);
+
+	/* Bulk resharing */
+	sss_reshare_keyshares(bulk, (const sss_Keyshare*) old, 3, 7, 4);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) bulk, 4);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Shrinking the policy, in place */
+	ctx = sss_ctx_new(7, 4);
+	assert(ctx != NULL);
+	sss_reshare_keyshares_ctx(ctx, bulk, (const sss_Keyshare*) &bulk[2],
+	                          4, 2, 2);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) bulk, 2);
+	assert(memcmp(key, restored, 32) == 0);
+	sss_ctx_free(ctx);
+}
+
+
+/*
+ * Reference multiplication in GF(2^8) with the AES polynomial
+ */
+static uint8_t mul(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+
+	while (b != 0) {
+		if (b & 1) r ^= a;
+		a = (a << 1) ^ (a & 0x80 ? 0x1b : 0);
+		b >>= 1;
+	}
+	return r;
+}
+
+
+static void test_keyshare_arithmetic(void)
+{
+	uint8_t key1[32], key2[32], key3[32], restored[32];
+	uint8_t coeffs[3] = { 0x03, 0x01, 0xca };
+	sss_Keyshare ks1[5], ks2[5], ks3[5], out[5];
+	const sss_Keyshare *sharings[3];
+	size_t idx;
+
+	for (idx = 0; idx < 32; idx++) {
+		key1[idx] = idx;
+		key2[idx] = 0xa5 ^ (idx * 7);
+		key3[idx] = 255 - idx;
+	}
+	sss_create_keyshares(ks1, key1, 5, 3);
+	sss_create_keyshares(ks2, key2, 5, 3);
+	sss_create_keyshares(ks3, key3, 5, 3);
+
+	/* Addition */
+	assert(sss_add_keyshares(out, (const sss_Keyshare*) ks1,
+	                         (const sss_Keyshare*) ks2, 5) == 0);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &out[2], 3);
+	for (idx = 0; idx < 32; idx++) {
+		assert(restored[idx] == (key1[idx] ^ key2[idx]));
+	}
+
+	/* Scaling by a constant */
+	sss_scale_keyshares(out, (const sss_Keyshare*) ks3, coeffs[2], 5);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) out, 3);
+	for (idx = 0; idx < 32; idx++) {
+		assert(restored[idx] == mul(coeffs[2], key3[idx]));
+	}
+
+	/* Linear combination */
+	sharings[0] = (const sss_Keyshare*) ks1;
+	sharings[1] = (const sss_Keyshare*) ks2;
+	sharings[2] = (const sss_Keyshare*) ks3;
+	assert(sss_linear_combine_keyshares(out, sharings, coeffs, 3, 5) == 0);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &out[1], 3);
+	for (idx = 0; idx < 32; idx++) {
+		assert(restored[idx] == (mul(coeffs[0], key1[idx]) ^ key2[idx] ^
+		                         mul(coeffs[2], key3[idx])));
+	}
+
+	/* Mismatching x values */
+	ks2[4][0] = 9;
+	assert(sss_add_keyshares(out, (const sss_Keyshare*) ks1,
+	                         (const sss_Keyshare*) ks2, 5) == -1);
+	assert(sss_linear_combine_keyshares(out, sharings, coeffs, 3, 5) == -1);
+
+	/* An empty combination */
+	assert(sss_linear_combine_keyshares(out, sharings, coeffs, 0, 5) == -1);
+}
+
+
+static void test_packed_key_shares(void)
+{
+	uint8_t keys[16][32], restored[16][32];
+	sss_Keyshare key_shares[240];
+	size_t idx;
+
+	for (idx = 0; idx < sizeof(keys); idx++) {
+		keys[idx / 32][idx % 32] = idx * 13;
+	}
+
+	sss_create_packed_keyshares(key_shares, (const uint8_t (*)[32]) keys,
+	                            4, 10, 3);
+	sss_combine_packed_keyshares(restored, 4,
+	                             (const sss_Keyshare*) &key_shares[3], 3);
+	assert(memcmp(keys, restored, 4 * 32) == 0);
+
+	/* One key is the same as ordinary sharing with threshold k + 1 */
+	sss_create_packed_keyshares(key_shares, (const uint8_t (*)[32]) keys,
+	                            1, 5, 2);
+	sss_combine_keyshares(restored[0], (const sss_Keyshare*) key_shares, 3);
+	assert(memcmp(keys, restored, 32) == 0);
+
+	/* Largest committee for 16 keys */
+	sss_create_packed_keyshares(key_shares, (const uint8_t (*)[32]) keys,
+	                            16, 240, 200);
+	sss_combine_packed_keyshares(restored, 16,
+	                             (const sss_Keyshare*) &key_shares[24], 200);
+	assert(memcmp(keys, restored, sizeof(keys)) == 0);
+	sss_combine_packed_keyshares(restored, 16,
+	                             (const sss_Keyshare*) &key_shares[25], 199);
+	assert(memcmp(keys, restored, sizeof(keys)) != 0);
+}
+
+
+static void test_policy_key_shares(void)
+{
+	uint8_t key[32], restored[32];
+	sss_Keyshare key_shares[9], subset[5];
+	unsigned mask;
+	size_t idx, count;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	/* Every set of 5 out of 9 shares, in reverse order */
+	sss_create_keyshares(key_shares, key, 9, 5);
+	for (mask = 0; mask < (1 << 9); mask++) {
+		count = 0;
+		for (idx = 9; idx-- > 0;) {
+			if (!(mask >> idx & 1) || count == 5) continue;
+			memcpy(subset[count++], key_shares[idx], sizeof(sss_Keyshare));
+		}
+		if (count != 5) continue;
+		sss_combine_keyshares(restored, (const sss_Keyshare*) subset, 5);
+		assert(memcmp(key, restored, 32) == 0);
+	}
+
+	/* Duplicate x values are not restored */
+	memcpy(subset[1], subset[0], sizeof(sss_Keyshare));
+	sss_combine_keyshares(restored, (const sss_Keyshare*) subset, 5);
+	assert(memcmp(key, restored, 32) != 0);
+
+	/* Shares from outside of the policy */
+	sss_create_keyshares(key_shares, key, 7, 5);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &key_shares[2], 5);
+	assert(memcmp(key, restored, 32) == 0);
+}
+
+
+static void test_bitsliced_key_shares(void)
+{
+	uint8_t key[32], restored[32];
+	sss_Keyshare key_shares[10];
+	sss_BitslicedKeyshare bs[10];
+	size_t idx;
+
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	/* Deal, refresh and combine without leaving the bitsliced form */
+	sss_create_keyshares_bitsliced(bs, key, 10, 4);
+	sss_refresh_keyshares_bitsliced(bs, 10, 4);
+	sss_combine_keyshares_bitsliced(restored,
+	                                (const sss_BitslicedKeyshare*) &bs[5], 4);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Conversions */
+	sss_unbitslice_keyshares(key_shares, (const sss_BitslicedKeyshare*) bs,
+	                         10);
+	for (idx = 0; idx < 10; idx++) assert(key_shares[idx][0] == idx + 1);
+	sss_combine_keyshares(restored, (const sss_Keyshare*) &key_shares[2], 4);
+	assert(memcmp(key, restored, 32) == 0);
+	sss_create_keyshares(key_shares, key, 10, 4);
+	sss_bitslice_keyshares(bs, (const sss_Keyshare*) key_shares, 10);
+	sss_combine_keyshares_bitsliced(restored,
+	                                (const sss_BitslicedKeyshare*) bs, 4);
+	assert(memcmp(key, restored, 32) == 0);
+}
+
+
 int main(void)
 {
 	test_key_shares();
+	test_precomputed_key_shares();
+	test_ctx_key_shares();
+	test_threaded_key_shares();
+	test_incremental_combine();
+	test_robust_combine();
+	test_keyshare_generator();
+	test_enroll_key_shares();
+	test_refresh_key_shares();
+	test_reshare_key_shares();
+	test_keyshare_arithmetic();
+	test_packed_key_shares();
+	test_policy_key_shares();
+	test_bitsliced_key_shares();
 	return 0;
 }
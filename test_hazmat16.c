@@ -0,0 +1,62 @@
+#include "hazmat16.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+int main(void)
+{
+	uint8_t key[32], restored[32];
+	sss_Keyshare16 *key_shares;
+	uint16_t *weights, xs[1000];
+	size_t idx;
+
+	key_shares = malloc(5000 * sizeof(sss_Keyshare16));
+	weights = malloc(1000 * sizeof(uint16_t));
+	assert(key_shares != NULL && weights != NULL);
+	for (idx = 0; idx < 32; idx++) {
+		key[idx] = idx;
+	}
+
+	/* Normal operation */
+	assert(sss_create_keyshares16(key_shares, key, 1, 1) == 0);
+	assert(sss_combine_keyshares16(restored,
+	       (const sss_Keyshare16*) key_shares, 1) == 0);
+	assert(memcmp(key, restored, 32) == 0);
+
+	assert(sss_create_keyshares16(key_shares, key, 5, 3) == 0);
+	assert(sss_keyshare16_x(key_shares[4]) == 5);
+	assert(sss_combine_keyshares16(restored,
+	       (const sss_Keyshare16*) &key_shares[2], 3) == 0);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* More than 255 shares */
+	assert(sss_create_keyshares16(key_shares, key, 5000, 1000) == 0);
+	assert(sss_keyshare16_x(key_shares[4999]) == 5000);
+	assert(sss_combine_keyshares16(restored,
+	       (const sss_Keyshare16*) &key_shares[4000], 1000) == 0);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Precomputed weights */
+	for (idx = 0; idx < 1000; idx++) {
+		xs[idx] = sss_keyshare16_x(key_shares[3000 + idx]);
+	}
+	assert(sss_lagrange_weights16(weights, xs, 1000) == 0);
+	sss_combine_keyshares16_weights(restored,
+	       (const sss_Keyshare16*) &key_shares[3000], weights, 1000);
+	assert(memcmp(key, restored, 32) == 0);
+
+	/* Not enough shares */
+	assert(sss_combine_keyshares16(restored,
+	       (const sss_Keyshare16*) key_shares, 999) == 0);
+	assert(memcmp(key, restored, 32) != 0);
+
+	/* Duplicate x values */
+	memcpy(key_shares[1], key_shares[0], sizeof(sss_Keyshare16));
+	assert(sss_combine_keyshares16(restored,
+	       (const sss_Keyshare16*) key_shares, 3) == -1);
+
+	free(key_shares);
+	free(weights);
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include "pool.h"
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+
+/*
+ * Take tickets from the pool while other threads do the same
+ */
+static void* consume(void *arg)
+{
+	unsigned char data[sss_MLEN] = { 7 }, restored[sss_MLEN];
+	sss_Share shares[5];
+	sss_Pool *pool = arg;
+	int idx;
+
+	for (idx = 0; idx < 64; idx++) {
+		data[1] = idx;
+		sss_pool_create_shares(pool, shares, data);
+		assert(sss_combine_shares(restored, (const sss_Share*) shares,
+		                          3) == 0);
+		assert(memcmp(restored, data, sss_MLEN) == 0);
+	}
+	return NULL;
+}
+
+
+int main(void)
+{
+	pthread_t threads[4];
+	unsigned char data[sss_MLEN] = { 42 }, restored[sss_MLEN];
+	sss_Share shares[5];
+	sss_Pool *pool;
+	int tmp;
+
+	/* Empty pool computes the ticket on the spot */
+	pool = sss_pool_new(5, 3, 4);
+	assert(pool != NULL);
+	assert(sss_pool_available(pool) == 0);
+	sss_pool_create_shares(pool, shares, data);
+	tmp = sss_combine_shares(restored, (const sss_Share*) shares, 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	/* Synchronous refill */
+	sss_pool_refill(pool);
+	assert(sss_pool_available(pool) == 4);
+	sss_pool_create_shares(pool, shares, data);
+	assert(sss_pool_available(pool) == 3);
+	tmp = sss_combine_shares(restored, (const sss_Share*) &shares[2], 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	/* Not enough shares to restore secret */
+	tmp = sss_combine_shares(restored, (const sss_Share*) shares, 2);
+	assert(tmp == -1);
+
+	/* Background refill */
+	assert(sss_pool_start(pool) == 0);
+	for (tmp = 0; tmp < 16; tmp++) {
+		data[1] = tmp;
+		sss_pool_create_shares(pool, shares, data);
+		assert(sss_combine_shares(restored, (const sss_Share*) shares,
+		                          3) == 0);
+		assert(memcmp(restored, data, sss_MLEN) == 0);
+	}
+
+	/* Concurrent consumers never share a ticket */
+	for (tmp = 0; tmp < 4; tmp++) {
+		assert(pthread_create(&threads[tmp], NULL, consume, pool) == 0);
+	}
+	for (tmp = 0; tmp < 4; tmp++) pthread_join(threads[tmp], NULL);
+	sss_pool_free(pool);
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "queue.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+
+#define COUNT 100000
+
+static void* producer(void *arg)
+{
+	sss_Queue *queue = arg;
+	size_t items[7], idx, next = 0;
+
+	while (next < COUNT) {
+		for (idx = 0; idx < 7 && next < COUNT; idx++) items[idx] = next++;
+		assert(sss_queue_push(queue, items, idx) == idx);
+	}
+	sss_queue_close(queue);
+	return NULL;
+}
+
+int main(void)
+{
+	sss_Queue *queue;
+	pthread_t thread;
+	size_t items[10], idx, got, expected = 0;
+
+	/* Items arrive in order, through a queue that is smaller than a batch */
+	queue = sss_queue_new(sizeof(size_t), 5);
+	assert(queue != NULL);
+	assert(pthread_create(&thread, NULL, producer, queue) == 0);
+	while ((got = sss_queue_pop(queue, items, 10)) > 0) {
+		for (idx = 0; idx < got; idx++) assert(items[idx] == expected++);
+	}
+	assert(expected == COUNT);
+	pthread_join(thread, NULL);
+
+	/* Pushing to a closed queue fails */
+	assert(sss_queue_push(queue, items, 1) == 0);
+	sss_queue_free(queue);
+	return 0;
+}
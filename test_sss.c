@@ -5,7 +5,14 @@
 int main(void)
 {
 	unsigned char data[sss_MLEN] = { 42 }, restored[sss_MLEN];
+	unsigned char other[sss_MLEN];
 	sss_Share shares[256];
+	uint8_t faulty[256];
+	sss_VersionedShare vshares[256];
+	sss_Ctx *ctx;
+	sss_Combiner *combiner;
+	sss_ShareGenerator *generator;
+	uint8_t seed[32];
 	int tmp;
 
 	/* Normal operation */
@@ -31,5 +38,144 @@ int main(void)
 	assert(tmp == 0);
 	assert(memcmp(restored, data, sss_MLEN) == 0);
 
+	/* Reusable workspace */
+	ctx = sss_ctx_new(255, 255);
+	assert(ctx != NULL);
+	sss_create_shares_ctx(ctx, shares, data, 5, 3);
+	tmp = sss_combine_shares_ctx(ctx, restored, (const sss_Share*) shares, 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	sss_create_shares_ctx(ctx, shares, data, 5, 3);
+	tmp = sss_combine_shares_ctx(ctx, restored, (const sss_Share*) shares, 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	tmp = sss_combine_shares_ctx(ctx, restored, (const sss_Share*) shares, 2);
+	assert(tmp == -1);
+	sss_create_shares_ctx(ctx, shares, data, 255, 255);
+	tmp = sss_combine_shares_ctx(ctx, restored, (const sss_Share*) shares,
+	                             255);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	sss_ctx_free(ctx);
+
+	/* Incremental combine */
+	sss_create_shares(shares, data, 5, 3);
+	combiner = sss_combiner_new(3);
+	assert(combiner != NULL);
+	assert(sss_combiner_add(combiner, (const sss_Share*) &shares[4]) == 0);
+	assert(sss_combiner_add(combiner, (const sss_Share*) &shares[4]) == -1);
+	assert(sss_combiner_add(combiner, (const sss_Share*) &shares[0]) == 0);
+	tmp = sss_combiner_finalize(combiner, restored);
+	assert(tmp == -1);
+	assert(sss_combiner_add(combiner, (const sss_Share*) &shares[2]) == 0);
+	tmp = sss_combiner_finalize(combiner, restored);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	sss_combiner_free(combiner);
+
+	/* Correcting faulty shares */
+	sss_create_shares(shares, data, 9, 5);
+	tmp = sss_combine_shares_robust(restored, faulty,
+	                                (const sss_Share*) shares, 9, 5);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	shares[2][10] ^= 1; /* key share */
+	shares[6][sss_KEYSHARE_LEN + 3] ^= 1; /* ciphertext */
+	tmp = sss_combine_shares_robust(restored, faulty,
+	                                (const sss_Share*) shares, 9, 5);
+	assert(tmp == 2);
+	assert(faulty[0] == 2 && faulty[1] == 6);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	shares[7][sss_KEYSHARE_LEN + 3] ^= 1;
+	tmp = sss_combine_shares_robust(restored, faulty,
+	                                (const sss_Share*) shares, 9, 5);
+	assert(tmp == -1);
+
+	/* Versioned shares only need the first k distinct shares */
+	sss_create_versioned_shares(vshares, data, 200, 100);
+	assert(sss_versioned_share_threshold(
+	       (const sss_VersionedShare*) &vshares[0]) == 100);
+	tmp = sss_combine_versioned_shares(restored,
+	      (const sss_VersionedShare*) vshares, 200, 1);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	tmp = sss_combine_versioned_shares(restored,
+	      (const sss_VersionedShare*) vshares, 99, 0);
+	assert(tmp == -1);
+
+	/* Duplicates are skipped */
+	memcpy(vshares[1], vshares[0], sizeof(sss_VersionedShare));
+	tmp = sss_combine_versioned_shares(restored,
+	      (const sss_VersionedShare*) vshares, 101, 1);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	/* A corrupted surplus share is caught by the spot check */
+	vshares[150][sss_HEADER_LEN + 1] ^= 1;
+	tmp = sss_combine_versioned_shares(restored,
+	      (const sss_VersionedShare*) vshares, 200, 0);
+	assert(tmp == 0);
+	tmp = sss_combine_versioned_shares(restored,
+	      (const sss_VersionedShare*) vshares, 200, 1);
+	assert(tmp == -1);
+
+	/* The threshold in the header is authenticated */
+	sss_create_versioned_shares(vshares, data, 5, 3);
+	for (tmp = 0; tmp < 5; tmp++) vshares[tmp][1] = 2;
+	tmp = sss_combine_versioned_shares(restored,
+	      (const sss_VersionedShare*) vshares, 5, 0);
+	assert(tmp == -1);
+
+	/* Shares from a generator can be issued again from the seed */
+	generator = sss_share_generator_new(NULL, data, NULL, 4);
+	assert(generator != NULL);
+	assert(sss_share_generator_get(generator, &shares[0], 0) == -1);
+	for (tmp = 0; tmp < 5; tmp++) {
+		assert(sss_share_generator_get(generator, &shares[tmp],
+		                               tmp + 1) == 0);
+	}
+	sss_share_generator_seed(generator, seed);
+	sss_share_generator_free(generator);
+	tmp = sss_combine_shares(restored, (const sss_Share*) &shares[1], 4);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	generator = sss_share_generator_new(NULL, data, seed, 4);
+	assert(generator != NULL);
+	sss_share_generator_get(generator, &shares[5], 3);
+	assert(memcmp(shares[5], shares[2], sizeof(sss_Share)) == 0);
+	sss_share_generator_free(generator);
+
+	/*
+	 * Other data under the same seed gets another key and polynomial, so
+	 * the shares and the ciphertexts of the two secrets are unrelated
+	 */
+	for (tmp = 0; tmp < sss_MLEN; tmp++) {
+		other[tmp] = data[tmp] ^ 0xff;
+	}
+	generator = sss_share_generator_new(NULL, other, seed, 4);
+	assert(generator != NULL);
+	sss_share_generator_get(generator, &shares[5], 3);
+	sss_share_generator_free(generator);
+	assert(memcmp(shares[5], shares[2], sss_KEYSHARE_LEN) != 0);
+	for (tmp = 0; tmp < sss_CLEN; tmp++) {
+		shares[5][sss_KEYSHARE_LEN + tmp] ^= shares[2][sss_KEYSHARE_LEN + tmp];
+	}
+	for (tmp = 0; tmp < sss_MLEN; tmp++) {
+		if (shares[5][sss_KEYSHARE_LEN + 16 + tmp] != 0xff) break;
+	}
+	assert(tmp < sss_MLEN);
+
+	/* Resharing 2-of-3 to 3-of-4 */
+	sss_create_shares(shares, data, 3, 2);
+	tmp = sss_reshare_shares(&shares[3], (const sss_Share*) &shares[1],
+	                         2, 4, 3);
+	assert(tmp == 0);
+	tmp = sss_combine_shares(restored, (const sss_Share*) &shares[4], 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	shares[1][sss_KEYSHARE_LEN] ^= 1;
+	tmp = sss_reshare_shares(&shares[3], (const sss_Share*) shares, 2, 4, 3);
+	assert(tmp == -1);
+
 	return 0;
 }
@@ -0,0 +1,56 @@
+#include "sss16.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(void)
+{
+	unsigned char data[sss_MLEN] = { 42 }, restored[sss_MLEN];
+	sss_Share16 *shares, *picked;
+	uint16_t weights[300], xs[300];
+	int tmp;
+
+	shares = malloc(1000 * sizeof(sss_Share16));
+	picked = malloc(300 * sizeof(sss_Share16));
+	assert(shares != NULL && picked != NULL);
+
+	/* Normal operation */
+	assert(sss_create_shares16(shares, data, 1000, 300) == 0);
+	tmp = sss_combine_shares16(restored,
+	                           (const sss_Share16*) &shares[700], 300);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	/* Precomputed weights, shared by two secrets */
+	for (tmp = 0; tmp < 300; tmp++) xs[tmp] = sss_share16_x(shares[tmp * 3]);
+	assert(sss_lagrange_weights16(weights, xs, 300) == 0);
+	for (tmp = 0; tmp < 300; tmp++) {
+		memcpy(picked[tmp], shares[tmp * 3], sizeof(sss_Share16));
+	}
+	tmp = sss_combine_shares16_weights(restored,
+	      (const sss_Share16*) picked, weights, 300);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+	data[1] = 43;
+	assert(sss_create_shares16(shares, data, 1000, 300) == 0);
+	for (tmp = 0; tmp < 300; tmp++) {
+		memcpy(picked[tmp], shares[tmp * 3], sizeof(sss_Share16));
+	}
+	tmp = sss_combine_shares16_weights(restored,
+	      (const sss_Share16*) picked, weights, 300);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	/* Not enough shares to restore secret */
+	tmp = sss_combine_shares16(restored, (const sss_Share16*) shares, 299);
+	assert(tmp == -1);
+
+	/* Corrupted ciphertext */
+	shares[1][sss_KEYSHARE16_LEN] ^= 1;
+	tmp = sss_combine_shares16(restored, (const sss_Share16*) shares, 300);
+	assert(tmp == -1);
+
+	free(shares);
+	free(picked);
+	return 0;
+}
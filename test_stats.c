@@ -0,0 +1,37 @@
+#include "sss.h"
+#include "stats.h"
+#include <assert.h>
+#include <string.h>
+
+int main(void)
+{
+	unsigned char data[sss_MLEN] = { 42 }, restored[sss_MLEN];
+	sss_Share shares[5];
+	sss_Stats before, after;
+	int enabled;
+
+	enabled = sss_stats_snapshot(&before) == 0;
+	sss_create_shares(shares, data, 5, 4);
+	assert(sss_combine_shares(restored, (const sss_Share*) shares, 4) == 0);
+	shares[1][sss_KEYSHARE_LEN] ^= 1;
+	assert(sss_combine_shares(restored, (const sss_Share*) shares, 4) == -1);
+	sss_stats_snapshot(&after);
+
+	if (!enabled) {
+		/* Built without sss_STATS: nothing is counted */
+		memset(&before, 0, sizeof(before));
+		assert(memcmp(&before, &after, sizeof(after)) == 0);
+		return 0;
+	}
+	assert(after.create_calls == before.create_calls + 1);
+	assert(after.combine_calls == before.combine_calls + 2);
+	assert(after.combine_failures == before.combine_failures + 1);
+	assert(after.bytes_created == before.bytes_created + sss_MLEN);
+	assert(after.create_keyshares_calls == before.create_keyshares_calls + 1);
+	assert(after.combine_keyshares_calls > before.combine_keyshares_calls);
+	assert(after.gf256_muls > before.gf256_muls);
+	assert(after.gf256_invs > before.gf256_invs);
+	assert(after.aead_ticks > before.aead_ticks);
+	assert(after.transpose_ticks > before.transpose_ticks);
+	return 0;
+}
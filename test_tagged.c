@@ -0,0 +1,59 @@
+#include "tagged.h"
+#include <assert.h>
+#include <string.h>
+
+#define SHARE(idx) ((const sss_TaggedShare*) &shares[idx])
+
+int main(void)
+{
+	unsigned char data[sss_MLEN] = { 42 }, restored[sss_MLEN];
+	uint8_t root[sss_TAG_HASH_LEN];
+	sss_TaggedShare shares[255];
+	size_t idx;
+	int tmp;
+
+	/* Normal operation */
+	sss_create_tagged_shares(shares, data, 5, 3);
+	sss_tagged_share_root(root, SHARE(0));
+	for (idx = 0; idx < 5; idx++) {
+		assert(sss_verify_tagged_share(SHARE(idx), root) == 0);
+	}
+	tmp = sss_combine_tagged_shares(restored,
+	                                (const sss_TaggedShare*) &shares[2], 3);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	/* A corrupted key share is rejected on its own */
+	shares[1][5] ^= 1;
+	assert(sss_verify_tagged_share(SHARE(1), root) == -1);
+	assert(sss_verify_tagged_share(SHARE(1), NULL) == -1);
+	tmp = sss_combine_tagged_shares(restored,
+	                                (const sss_TaggedShare*) shares, 3);
+	assert(tmp == -1);
+	shares[1][5] ^= 1;
+
+	/* A forged root is not consistent with the path */
+	shares[4][sss_SHARE_LEN] ^= 1;
+	assert(sss_verify_tagged_share(SHARE(4), NULL) == -1);
+	shares[4][sss_SHARE_LEN] ^= 1;
+
+	/* Shares of another secret are rejected */
+	sss_create_tagged_shares(&shares[5], data, 5, 3);
+	assert(sss_verify_tagged_share(SHARE(5), root) == -1);
+	memcpy(shares[2], shares[7], sizeof(sss_TaggedShare));
+	tmp = sss_combine_tagged_shares(restored,
+	                                (const sss_TaggedShare*) shares, 3);
+	assert(tmp == -1);
+
+	/* A lot of shares */
+	sss_create_tagged_shares(shares, data, 255, 200);
+	sss_tagged_share_root(root, SHARE(0));
+	assert(sss_verify_tagged_share(SHARE(254), root) == 0);
+	tmp = sss_combine_tagged_shares(restored,
+	                                (const sss_TaggedShare*) &shares[55],
+	                                200);
+	assert(tmp == 0);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	return 0;
+}
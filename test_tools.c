@@ -0,0 +1,290 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "archive.h"
+#include "sss.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * End-to-end tests for sss-split, sss-recover and sss-daemon. These run the
+ * tools from the current directory, so `make check` builds them first.
+ */
+
+#define COUNT 10001
+#define RECORD_LEN (8 + sss_MLEN)
+#define SOCKET_PATH "test_tools.sock"
+
+/*
+ * Amount of counters in the response to a stats request of sss-daemon
+ */
+#define DAEMON_STATS_LEN 24
+
+static uint8_t secrets[COUNT][RECORD_LEN];
+
+
+/*
+ * Run `command` with the shell, and return its exit status
+ */
+static int run(const char *command)
+{
+	int status = system(command);
+
+	assert(status != -1 && WIFEXITED(status));
+	return WEXITSTATUS(status);
+}
+
+
+/*
+ * Read the file at `path` into a fresh buffer, and write its length to `len`
+ */
+static uint8_t* read_file(const char *path, size_t *len)
+{
+	struct stat st;
+	uint8_t *buf;
+	FILE *file;
+
+	assert(stat(path, &st) == 0);
+	*len = st.st_size;
+	buf = malloc(*len + 1);
+	assert(buf != NULL);
+	file = fopen(path, "rb");
+	assert(file != NULL);
+	assert(fread(buf, 1, *len, file) == *len);
+	fclose(file);
+	buf[*len] = 0;
+	return buf;
+}
+
+
+static void write_file(const char *path, const uint8_t *buf, size_t len)
+{
+	FILE *file = fopen(path, "wb");
+
+	assert(file != NULL);
+	assert(fwrite(buf, 1, len, file) == len);
+	assert(fclose(file) == 0);
+}
+
+
+static int compare_records(const void *a, const void *b)
+{
+	uint64_t x = sss_stream_get_id(a), y = sss_stream_get_id(b);
+	return (x > y) - (x < y);
+}
+
+
+/*
+ * Count the lines in the file at `path` that contain `needle`
+ */
+static size_t count_lines(const char *path, const char *needle)
+{
+	char *buf, *line, *end;
+	size_t len, count = 0;
+
+	buf = (char*) read_file(path, &len);
+	for (line = buf; *line != 0; line = end + 1) {
+		end = strchr(line, '\n');
+		if (end == NULL) break;
+		*end = 0;
+		if (strstr(line, needle) != NULL) count++;
+	}
+	free(buf);
+	return count;
+}
+
+
+static void test_split_recover(void)
+{
+	uint8_t *buf, *tmp;
+	size_t idx, len;
+
+	/* Split a vault into 5 streams with a threshold of 3 */
+	for (idx = 0; idx < COUNT; idx++) {
+		sss_stream_put_id(secrets[idx], idx * 3 + 1);
+		memset(&secrets[idx][8], (int) (idx * 7), sss_MLEN);
+		secrets[idx][8] = (uint8_t) (idx >> 8);
+	}
+	write_file("test_tools.in", &secrets[0][0], sizeof(secrets));
+	assert(run("./sss-split -k 3 -i test_tools.in test_tools.s0 "
+	           "test_tools.s1 test_tools.s2 test_tools.s3 test_tools.s4 "
+	           "2> /dev/null") == 0);
+
+	/* Any 3 streams restore every secret */
+	assert(run("./sss-recover -o test_tools.vault test_tools.s4 "
+	           "test_tools.s1 test_tools.s3 2> /dev/null") == 0);
+	buf = read_file("test_tools.vault", &len);
+	assert(len == sizeof(secrets));
+	qsort(buf, COUNT, RECORD_LEN, compare_records);
+	assert(memcmp(buf, secrets, sizeof(secrets)) == 0);
+	free(buf);
+
+	/* With k - 1 streams, every secret fails */
+	assert(run("./sss-recover -o test_tools.vault test_tools.s0 "
+	           "test_tools.s2 2> test_tools.err") == 1);
+	assert(count_lines("test_tools.err", "could not restore secret")
+	       == COUNT);
+	assert(count_lines("test_tools.err", "restored 0 secrets (10001 failed, "
+	                   "0 incomplete)") == 1);
+	buf = read_file("test_tools.vault", &len);
+	assert(len == 0);
+	free(buf);
+
+	/* A truncated stream */
+	buf = read_file("test_tools.s2", &len);
+	write_file("test_tools.bad", buf, len - 1);
+	assert(run("./sss-recover -o test_tools.vault test_tools.s0 "
+	           "test_tools.s1 test_tools.bad 2> test_tools.err") == 1);
+	assert(count_lines("test_tools.err", "truncated stream") == 1);
+
+	/* A stream with two records swapped */
+	tmp = malloc(sss_STREAM_RECORD_LEN);
+	assert(tmp != NULL);
+	idx = sss_STREAM_HEADER_LEN + 100 * sss_STREAM_RECORD_LEN;
+	memcpy(tmp, &buf[idx], sss_STREAM_RECORD_LEN);
+	memcpy(&buf[idx], &buf[idx + sss_STREAM_RECORD_LEN],
+	       sss_STREAM_RECORD_LEN);
+	memcpy(&buf[idx + sss_STREAM_RECORD_LEN], tmp, sss_STREAM_RECORD_LEN);
+	write_file("test_tools.bad", buf, len);
+	assert(run("./sss-recover -o test_tools.vault test_tools.s0 "
+	           "test_tools.s1 test_tools.bad 2> test_tools.err") == 1);
+	assert(count_lines("test_tools.err", "not sorted") == 1);
+	free(tmp);
+	free(buf);
+
+	/* sss-split refuses truncated and unsorted input */
+	write_file("test_tools.in", &secrets[0][0], sizeof(secrets) - 1);
+	assert(run("./sss-split -k 2 -i test_tools.in test_tools.s0 "
+	           "test_tools.s1 2> /dev/null") == 1);
+	memcpy(secrets[0], secrets[1], 8);
+	write_file("test_tools.in", &secrets[0][0], sizeof(secrets));
+	assert(run("./sss-split -k 2 -i test_tools.in test_tools.s0 "
+	           "test_tools.s1 2> /dev/null") == 1);
+
+	remove("test_tools.in");
+	remove("test_tools.vault");
+	remove("test_tools.err");
+	remove("test_tools.bad");
+	remove("test_tools.s0");
+	remove("test_tools.s1");
+	remove("test_tools.s2");
+	remove("test_tools.s3");
+	remove("test_tools.s4");
+}
+
+
+static void send_all(int fd, const void *buf, size_t len)
+{
+	assert(write(fd, buf, len) == (ssize_t) len);
+}
+
+
+static void recv_all(int fd, void *buf, size_t len)
+{
+	uint8_t *out = buf;
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = read(fd, out, len);
+		assert(ret > 0);
+		out += ret;
+		len -= ret;
+	}
+}
+
+
+static void test_daemon(void)
+{
+	static const struct timespec delay = { 0, 10000000 };
+	static sss_Share shares[5];
+	uint8_t request[4 + 3 * sss_SHARE_LEN], data[sss_MLEN], restored[sss_MLEN];
+	uint8_t status, stats[DAEMON_STATS_LEN][8];
+	struct sockaddr_un addr;
+	size_t idx;
+	pid_t pid;
+	int fd, tries;
+
+	unlink(SOCKET_PATH);
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		execl("./sss-daemon", "sss-daemon", "-j", "2", "-d", "1000",
+		      SOCKET_PATH, (char*) NULL);
+		_exit(127);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, SOCKET_PATH);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert(fd >= 0);
+	for (tries = 0; tries < 500; tries++) {
+		if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0) break;
+		nanosleep(&delay, NULL);
+	}
+	assert(tries < 500);
+
+	/* Create 5 shares with a threshold of 3 */
+	for (idx = 0; idx < sss_MLEN; idx++) data[idx] = idx * 3;
+	request[0] = 1;
+	request[1] = 5;
+	request[2] = 3;
+	request[3] = 0;
+	memcpy(&request[4], data, sss_MLEN);
+	send_all(fd, request, 4 + sss_MLEN);
+	recv_all(fd, &status, 1);
+	assert(status == 0);
+	recv_all(fd, shares, sizeof(shares));
+
+	/* Combine 3 of them */
+	request[0] = 2;
+	request[1] = 0;
+	memcpy(&request[4], &shares[2], 3 * sss_SHARE_LEN);
+	send_all(fd, request, sizeof(request));
+	recv_all(fd, &status, 1);
+	assert(status == 0);
+	recv_all(fd, restored, sss_MLEN);
+	assert(memcmp(restored, data, sss_MLEN) == 0);
+
+	/* A corrupted share fails */
+	request[4 + sss_KEYSHARE_LEN] ^= 1;
+	send_all(fd, request, sizeof(request));
+	recv_all(fd, &status, 1);
+	assert(status == 1);
+
+	/* The creates, combines and failures are counted */
+	request[0] = 3;
+	send_all(fd, request, 4);
+	recv_all(fd, &status, 1);
+	assert(status == 0);
+	recv_all(fd, stats, sizeof(stats));
+	assert(stats[0][0] == 1 && stats[1][0] == 2 && stats[2][0] == 1);
+
+	/* An invalid request */
+	request[0] = 9;
+	send_all(fd, request, 4);
+	recv_all(fd, &status, 1);
+	assert(status == 2);
+
+	close(fd);
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	unlink(SOCKET_PATH);
+}
+
+
+int main(void)
+{
+	test_split_recover();
+	test_daemon();
+	return 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * Fork-join thread pool
+ *
+ * Author: Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * The worker threads sleep on a condition variable until a new job is
+ * published (which is signaled by bumping `generation`). Every worker then
+ * processes its own block of the items, and the last worker to finish wakes
+ * up the caller.
+ *
+ * For work-stealing jobs, every worker owns a range of items that is
+ * protected by its own mutex. A worker takes `grain` items at a time from the
+ * front of its own range. When its range is empty, it steals the back half
+ * of the range of another worker. The job is done when none of the workers
+ * can find any items anymore.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+
+typedef struct {
+	sss_Threadpool *pool;
+	size_t idx;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	size_t begin, end; /* remaining items of a work-stealing job */
+} Worker;
+
+
+struct sss_Threadpool {
+	size_t size, started;
+	Worker workers[sss_THREADPOOL_MAX];
+	pthread_mutex_t lock, run_lock;
+	pthread_cond_t work, done;
+	unsigned long generation;
+	size_t pending;
+	int stop;
+
+	/* The current job */
+	sss_Task fn;
+	void *arg;
+	size_t count, grain; /* `grain` is 0 for jobs without stealing */
+};
+
+
+/*
+ * Run the block of items that belongs to `worker`
+ */
+static void run_block(const sss_Threadpool *pool, sss_Task fn, void *arg,
+                      size_t count, size_t worker)
+{
+	size_t begin = count * worker / pool->size;
+	size_t end = count * (worker + 1) / pool->size;
+	if (begin < end) fn(arg, begin, end, worker);
+}
+
+
+/*
+ * Take at most `grain` items from the range of `worker`
+ */
+static int take(Worker *worker, size_t grain, size_t *begin, size_t *end)
+{
+	int ok;
+
+	pthread_mutex_lock(&worker->lock);
+	ok = worker->begin < worker->end;
+	if (ok) {
+		*begin = worker->begin;
+		*end = worker->end - worker->begin > grain
+		       ? worker->begin + grain : worker->end;
+		worker->begin = *end;
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return ok;
+}
+
+
+/*
+ * Steal the back half of the range of any other worker and make it the
+ * range of `worker`. Returns 0 if there was nothing left to steal.
+ */
+static int steal(sss_Threadpool *pool, Worker *worker, size_t grain)
+{
+	Worker *victim;
+	size_t idx, remaining, begin = 0, end = 0;
+
+	for (idx = 1; idx < pool->size && begin == end; idx++) {
+		victim = &pool->workers[(worker->idx + idx) % pool->size];
+		pthread_mutex_lock(&victim->lock);
+		remaining = victim->end - victim->begin;
+		if (remaining > 0) {
+			end = victim->end;
+			begin = remaining > grain
+			        ? victim->begin + remaining / 2 : victim->begin;
+			victim->end = begin;
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+	if (begin == end) return 0;
+
+	pthread_mutex_lock(&worker->lock);
+	worker->begin = begin;
+	worker->end = end;
+	pthread_mutex_unlock(&worker->lock);
+	return 1;
+}
+
+
+/*
+ * Process items of a work-stealing job until there are none left
+ */
+static void run_stealing(sss_Threadpool *pool, sss_Task fn, void *arg,
+                         size_t grain, size_t worker)
+{
+	Worker *self = &pool->workers[worker];
+	size_t begin, end;
+
+	do {
+		while (take(self, grain, &begin, &end)) {
+			fn(arg, begin, end, worker);
+		}
+	} while (steal(pool, self, grain));
+}
+
+
+/*
+ * Run the part of the current job that belongs to `worker`
+ */
+static void run_job(sss_Threadpool *pool, sss_Task fn, void *arg,
+                    size_t count, size_t grain, size_t worker)
+{
+	if (grain == 0) {
+		run_block(pool, fn, arg, count, worker);
+	} else {
+		run_stealing(pool, fn, arg, grain, worker);
+	}
+}
+
+
+static void* worker_main(void *arg)
+{
+	Worker *worker = arg;
+	sss_Threadpool *pool = worker->pool;
+	unsigned long seen = 0;
+	sss_Task fn;
+	void *fn_arg;
+	size_t count, grain;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->generation == seen && !pool->stop) {
+			pthread_cond_wait(&pool->work, &pool->lock);
+		}
+		if (pool->stop) break;
+		seen = pool->generation;
+		fn = pool->fn;
+		fn_arg = pool->arg;
+		count = pool->count;
+		grain = pool->grain;
+		pthread_mutex_unlock(&pool->lock);
+
+		run_job(pool, fn, fn_arg, count, grain, worker->idx);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->pending == 0) pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+
+sss_Threadpool* sss_threadpool_new(size_t size)
+{
+	sss_Threadpool *pool;
+	size_t idx;
+
+	if (size < 1) size = 1;
+	if (size > sss_THREADPOOL_MAX) size = sss_THREADPOOL_MAX;
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) return NULL;
+	pool->size = size;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_init(&pool->run_lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	for (idx = 0; idx < size; idx++) {
+		pthread_mutex_init(&pool->workers[idx].lock, NULL);
+	}
+
+	/* Worker 0 is the calling thread */
+	for (idx = 1; idx < size; idx++) {
+		pool->workers[idx].pool = pool;
+		pool->workers[idx].idx = idx;
+		if (pthread_create(&pool->workers[idx].thread, NULL,
+		                   worker_main, &pool->workers[idx]) != 0) {
+			sss_threadpool_free(pool);
+			return NULL;
+		}
+		pool->started++;
+	}
+	return pool;
+}
+
+
+size_t sss_threadpool_size(const sss_Threadpool *pool)
+{
+	return pool->size;
+}
+
+
+static void run(sss_Threadpool *pool, sss_Task fn, void *arg,
+                size_t count, size_t grain)
+{
+	size_t idx;
+
+	pthread_mutex_lock(&pool->run_lock);
+	pthread_mutex_lock(&pool->lock);
+	pool->fn = fn;
+	pool->arg = arg;
+	pool->count = count;
+	pool->grain = grain;
+	if (grain != 0) {
+		/* Every worker starts out with an equal share of the items */
+		for (idx = 0; idx < pool->size; idx++) {
+			pool->workers[idx].begin = count * idx / pool->size;
+			pool->workers[idx].end = count * (idx + 1) / pool->size;
+		}
+	}
+	pool->pending = pool->size - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	run_job(pool, fn, arg, count, grain, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->pending > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	pthread_mutex_unlock(&pool->run_lock);
+}
+
+
+void sss_threadpool_run(sss_Threadpool *pool,
+                        sss_Task fn,
+                        void *arg,
+                        size_t count)
+{
+	run(pool, fn, arg, count, 0);
+}
+
+
+void sss_threadpool_run_stealing(sss_Threadpool *pool,
+                                 sss_Task fn,
+                                 void *arg,
+                                 size_t count,
+                                 size_t grain)
+{
+	run(pool, fn, arg, count, grain != 0 ? grain : 1);
+}
+
+
+void sss_threadpool_free(sss_Threadpool *pool)
+{
+	size_t idx;
+
+	if (pool == NULL) return;
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	for (idx = 1; idx <= pool->started; idx++) {
+		pthread_join(pool->workers[idx].thread, NULL);
+	}
+	for (idx = 0; idx < pool->size; idx++) {
+		pthread_mutex_destroy(&pool->workers[idx].lock);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->run_lock);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
@@ -0,0 +1,84 @@
+/*
+ * Thread pool for Daan Sprenkels' Shamir secret sharing library
+ * Copyright (c) 2017 Daan Sprenkels <hello@dsprenkels.com>
+ *
+ * A small fork-join thread pool that is used to spread the work of a single
+ * large create or combine call, or of a batch of calls, over multiple cores.
+ */
+
+
+#ifndef sss_THREADPOOL_H_
+#define sss_THREADPOOL_H_
+
+#include <stddef.h>
+
+
+/*
+ * Maximum number of workers in a thread pool
+ */
+#define sss_THREADPOOL_MAX 64
+
+
+typedef struct sss_Threadpool sss_Threadpool;
+
+
+/*
+ * A task that processes the items `begin..end-1` of a job. `worker` is the
+ * index of the worker that runs the task, which is less than the size of the
+ * pool.
+ */
+typedef void (*sss_Task)(void *arg, size_t begin, size_t end, size_t worker);
+
+
+/*
+ * Create a new thread pool with `size` workers. The thread that calls
+ * `sss_threadpool_run` is one of the workers, so this starts `size - 1`
+ * threads. `size` is clamped to `1..sss_THREADPOOL_MAX`.
+ *
+ * Returns NULL if the pool could not be created.
+ */
+sss_Threadpool* sss_threadpool_new(size_t size);
+
+
+/*
+ * Return the amount of workers in `pool`.
+ */
+size_t sss_threadpool_size(const sss_Threadpool *pool);
+
+
+/*
+ * Run `fn` on the items `0..count-1`, split into one contiguous block per
+ * worker, and wait until all of the workers are done.
+ *
+ * Calls from different threads are serialized.
+ */
+void sss_threadpool_run(sss_Threadpool *pool,
+                        sss_Task fn,
+                        void *arg,
+                        size_t count);
+
+
+/*
+ * Run `fn` on the items `0..count-1` and wait until all of them are done.
+ *
+ * Every worker starts with an equal share of the items and processes them
+ * in chunks of at most `grain` items. Workers that run out of items steal
+ * half of the remaining items of another worker, so the load stays balanced
+ * even if some of the items take a lot longer than others.
+ *
+ * Calls from different threads are serialized.
+ */
+void sss_threadpool_run_stealing(sss_Threadpool *pool,
+                                 sss_Task fn,
+                                 void *arg,
+                                 size_t count,
+                                 size_t grain);
+
+
+/*
+ * Stop all of the threads in `pool` and free it.
+ */
+void sss_threadpool_free(sss_Threadpool *pool);
+
+
+#endif /* sss_THREADPOOL_H_ */